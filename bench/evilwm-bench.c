@@ -0,0 +1,322 @@
+/* evilwm - minimalist window manager for X11
+ * Copyright (C) 1999-2025 Ciaran Anscomb <evilwm@6809.org.uk>
+ * see README for license and other details. */
+
+// Synthetic client driver for benchmarking.
+//
+// Connects to a display already managed by evilwm and runs a series of
+// scripted workloads against it, reporting the rate at which each was
+// completed.  Run through bench/run.sh, which sets up Xvfb and collects
+// evilwm's own statistics afterwards.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <X11/X.h>
+#include <X11/Xatom.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/keysym.h>
+
+#ifdef XTEST
+#include <X11/extensions/XTest.h>
+#endif
+
+static Display *dpy;
+static Window root;
+static int screen;
+
+static Atom net_supporting_wm_check;
+static Atom net_current_desktop;
+static Atom net_wm_state;
+static Atom net_wm_state_maximized_vert;
+static Atom net_wm_state_maximized_horz;
+
+static unsigned nwindows = 100;
+static unsigned nrepeat = 20;
+static Window *windows;
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *workload, unsigned ops, double elapsed) {
+	printf("%-12s %8u ops %10.1f ms %12.1f ops/s\n", workload, ops,
+	       elapsed * 1000.0, elapsed > 0 ? ops / elapsed : 0.0);
+	fflush(stdout);
+}
+
+// Wait until n of the given windows have been reparented by the window
+// manager.
+
+static void wait_reparented(unsigned n) {
+	XEvent ev;
+	while (n > 0) {
+		XMaskEvent(dpy, StructureNotifyMask, &ev);
+		if (ev.type == ReparentNotify && ev.xreparent.parent != root)
+			n--;
+	}
+}
+
+// Wait for n events of the given type on our windows.
+
+static void wait_structure(int type, unsigned n) {
+	XEvent ev;
+	while (n > 0) {
+		XMaskEvent(dpy, StructureNotifyMask, &ev);
+		if (ev.type == type)
+			n--;
+	}
+}
+
+static Window create_window(int x, int y) {
+	XSetWindowAttributes attr;
+	attr.background_pixel = BlackPixel(dpy, screen);
+	attr.event_mask = StructureNotifyMask | PropertyChangeMask;
+	return XCreateWindow(dpy, root, x, y, 200, 150, 0, CopyFromParent,
+			     InputOutput, CopyFromParent,
+			     CWBackPixel | CWEventMask, &attr);
+}
+
+// Ensure evilwm has processed everything sent so far.  It handles events in
+// order, so once a freshly mapped probe window has been reparented, all
+// earlier requests will have been dealt with.
+
+static void wm_sync(void) {
+	Window probe = create_window(0, 0);
+	XMapWindow(dpy, probe);
+	wait_reparented(1);
+	XDestroyWindow(dpy, probe);
+	XSync(dpy, True);
+}
+
+static void send_root_message(Window w, Atom type, long l0, long l1, long l2, long l3) {
+	XEvent ev = { .xclient = {
+		.type = ClientMessage,
+		.window = w,
+		.message_type = type,
+		.format = 32,
+		.data.l = { l0, l1, l2, l3, 0 },
+	} };
+	XSendEvent(dpy, root, False, SubstructureRedirectMask | SubstructureNotifyMask, &ev);
+}
+
+// Wait up to ten seconds for a window manager to advertise itself on the
+// root window.
+
+static int wait_for_wm(void) {
+	for (int i = 0; i < 1000; i++) {
+		Atom type;
+		int format;
+		unsigned long nitems, after;
+		unsigned char *data = NULL;
+		if (XGetWindowProperty(dpy, root, net_supporting_wm_check, 0, 1,
+				       False, XA_WINDOW, &type, &format, &nitems,
+				       &after, &data) == Success && data) {
+			XFree(data);
+			if (nitems)
+				return 1;
+		}
+		nanosleep(&(struct timespec){ .tv_nsec = 10000000 }, NULL);
+	}
+	return 0;
+}
+
+// Map windows and wait for evilwm to manage them all.
+
+static void bench_map(void) {
+	double start = now();
+	for (unsigned i = 0; i < nwindows; i++) {
+		windows[i] = create_window((i * 13) % 600, (i * 7) % 400);
+		XMapWindow(dpy, windows[i]);
+	}
+	XFlush(dpy);
+	wait_reparented(nwindows);
+	report("map", nwindows, now() - start);
+}
+
+// Unmap windows, then map them again.  evilwm must have withdrawn each window
+// before it is mapped again, or the map would find it still in its frame and
+// never be redirected.  Completion is judged by MapNotify, which arrives
+// however the window ends up mapped.
+
+static void bench_remap(void) {
+	double start = now();
+	for (unsigned r = 0; r < nrepeat / 4 + 1; r++) {
+		for (unsigned i = 0; i < nwindows; i++)
+			XUnmapWindow(dpy, windows[i]);
+		wait_structure(UnmapNotify, nwindows);
+		wm_sync();
+		for (unsigned i = 0; i < nwindows; i++)
+			XMapWindow(dpy, windows[i]);
+		XFlush(dpy);
+		wait_structure(MapNotify, nwindows);
+	}
+	report("remap", (nrepeat / 4 + 1) * nwindows, now() - start);
+}
+
+// Many ConfigureRequests per window.
+
+static void bench_configure(void) {
+	double start = now();
+	for (unsigned r = 0; r < nrepeat; r++) {
+		for (unsigned i = 0; i < nwindows; i++) {
+			XMoveResizeWindow(dpy, windows[i], (i * 13 + r * 5) % 600,
+					  (i * 7 + r * 3) % 400, 200 + r, 150 + r);
+		}
+	}
+	wm_sync();
+	report("configure", nrepeat * nwindows, now() - start);
+}
+
+// Switch between the first two virtual desktops.
+
+static void bench_vdesk(void) {
+	double start = now();
+	for (unsigned r = 0; r < nrepeat; r++) {
+		send_root_message(root, net_current_desktop, (r + 1) & 1, CurrentTime, 0, 0);
+	}
+	send_root_message(root, net_current_desktop, 0, CurrentTime, 0, 0);
+	wm_sync();
+	report("vdesk", nrepeat + 1, now() - start);
+}
+
+// Toggle maximised state through _NET_WM_STATE client messages.
+
+static void bench_state(void) {
+	double start = now();
+	for (unsigned r = 0; r < nrepeat; r++) {
+		for (unsigned i = 0; i < nwindows; i += 10) {
+			send_root_message(windows[i], net_wm_state, 2,
+					  net_wm_state_maximized_vert,
+					  net_wm_state_maximized_horz, 1);
+		}
+	}
+	wm_sync();
+	report("state", nrepeat * ((nwindows + 9) / 10), now() - start);
+}
+
+#ifdef XTEST
+
+// Cycle through windows with Alt+Tab.
+
+static void bench_alttab(void) {
+	KeyCode alt = XKeysymToKeycode(dpy, XK_Alt_L);
+	KeyCode tab = XKeysymToKeycode(dpy, XK_Tab);
+	double start = now();
+	for (unsigned r = 0; r < nrepeat; r++) {
+		XTestFakeKeyEvent(dpy, alt, True, CurrentTime);
+		for (unsigned i = 0; i < 5; i++) {
+			XTestFakeKeyEvent(dpy, tab, True, CurrentTime);
+			XTestFakeKeyEvent(dpy, tab, False, CurrentTime);
+		}
+		XTestFakeKeyEvent(dpy, alt, False, CurrentTime);
+	}
+	wm_sync();
+	report("alttab", nrepeat * 5, now() - start);
+}
+
+// Drag the topmost window around with Alt+Button1.
+
+static void bench_drag(void) {
+	KeyCode alt = XKeysymToKeycode(dpy, XK_Alt_L);
+	unsigned nmotion = 0;
+	double start = now();
+	XRaiseWindow(dpy, windows[0]);
+	XMoveWindow(dpy, windows[0], 100, 100);
+	wm_sync();
+	for (unsigned r = 0; r < nrepeat; r++) {
+		XTestFakeMotionEvent(dpy, screen, 150, 150, CurrentTime);
+		XTestFakeKeyEvent(dpy, alt, True, CurrentTime);
+		XTestFakeButtonEvent(dpy, 1, True, CurrentTime);
+		for (unsigned i = 0; i < 200; i++) {
+			XTestFakeMotionEvent(dpy, screen, 150 + i, 150 + i / 2, CurrentTime);
+			nmotion++;
+		}
+		XTestFakeButtonEvent(dpy, 1, False, CurrentTime);
+		XTestFakeKeyEvent(dpy, alt, False, CurrentTime);
+		XMoveWindow(dpy, windows[0], 100, 100);
+	}
+	wm_sync();
+	report("drag", nmotion, now() - start);
+}
+
+#endif
+
+// Unmap and destroy all windows.
+
+static void bench_destroy(void) {
+	double start = now();
+	for (unsigned i = 0; i < nwindows; i++)
+		XDestroyWindow(dpy, windows[i]);
+	wm_sync();
+	report("destroy", nwindows, now() - start);
+}
+
+static void usage(const char *argv0) {
+	fprintf(stderr, "usage: %s [-n WINDOWS] [-r REPEAT]\n", argv0);
+	exit(1);
+}
+
+int main(int argc, char **argv) {
+	int opt;
+	while ((opt = getopt(argc, argv, "n:r:")) != -1) {
+		switch (opt) {
+		case 'n':
+			nwindows = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			nrepeat = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (nwindows < 1)
+		usage(argv[0]);
+
+	if (!(dpy = XOpenDisplay(NULL))) {
+		fprintf(stderr, "%s: can't open display\n", argv[0]);
+		exit(1);
+	}
+	screen = DefaultScreen(dpy);
+	root = RootWindow(dpy, screen);
+	net_supporting_wm_check = XInternAtom(dpy, "_NET_SUPPORTING_WM_CHECK", False);
+	net_current_desktop = XInternAtom(dpy, "_NET_CURRENT_DESKTOP", False);
+	net_wm_state = XInternAtom(dpy, "_NET_WM_STATE", False);
+	net_wm_state_maximized_vert = XInternAtom(dpy, "_NET_WM_STATE_MAXIMIZED_VERT", False);
+	net_wm_state_maximized_horz = XInternAtom(dpy, "_NET_WM_STATE_MAXIMIZED_HORZ", False);
+
+	if (!wait_for_wm()) {
+		fprintf(stderr, "%s: no window manager running\n", argv[0]);
+		exit(1);
+	}
+
+	windows = calloc(nwindows, sizeof(Window));
+	if (!windows) {
+		fprintf(stderr, "%s: out of memory\n", argv[0]);
+		exit(1);
+	}
+
+	bench_map();
+	bench_remap();
+	bench_configure();
+	bench_vdesk();
+	bench_state();
+#ifdef XTEST
+	bench_alttab();
+	bench_drag();
+#else
+	printf("alttab       skipped (built without XTEST)\n");
+	printf("drag         skipped (built without XTEST)\n");
+#endif
+	bench_destroy();
+
+	XCloseDisplay(dpy);
+	return 0;
+}
@@ -0,0 +1,171 @@
+/* evilwm - minimalist window manager for X11
+ * Copyright (C) 1999-2025 Ciaran Anscomb <evilwm@6809.org.uk>
+ * see README for license and other details. */
+
+// Micro-benchmark for monitor assignment.
+//
+// Scores randomly placed windows against a row of monitors, first one at a
+// time using floating point and sqrt() as client_monitor() used to, then with
+// monitor_closest().  Reports the time taken by each, and checks that they
+// agree.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "monitor.h"
+
+static unsigned nwindows = 1000;
+static unsigned nmonitors = 4;
+static unsigned nrepeat = 1000;
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int imin(int a, int b) {
+	return (a < b) ? a : b;
+}
+
+static int imax(int a, int b) {
+	return (a > b) ? a : b;
+}
+
+// The original scalar version.
+
+static int reference_monitor(const struct monitor *monitors, int n,
+			     int cx1, int cy1, int cx2, int cy2) {
+	int cmidx = (cx1 + cx2)/2;
+	int cmidy = (cy1 + cy2)/2;
+	int best = -1;
+	int have_intersection = 0;
+	double best_area_ratio = 0.0;
+	double best_distance = 0.0;
+
+	for (int i = 0; i < n; i++) {
+		const struct monitor *m = &monitors[i];
+		int mx2 = m->x + m->width;
+		int my2 = m->y + m->height;
+		int iw = imax(0, imin(mx2, cx2) - imax(m->x, cx1));
+		int ih = imax(0, imin(my2, cy2) - imax(m->y, cy1));
+		int iarea = iw * ih;
+		if (iarea > 0) {
+			double iarea_ratio = (double)iarea / (double)m->area;
+			if (!have_intersection || iarea_ratio > best_area_ratio) {
+				have_intersection = 1;
+				best_area_ratio = iarea_ratio;
+				best = i;
+				continue;
+			}
+		}
+		if (have_intersection)
+			continue;
+		int mmidx = (m->x + mx2)/2;
+		int mmidy = (m->y + my2)/2;
+		int dx = abs(cmidx - mmidx);
+		int dy = abs(cmidy - mmidy);
+		double d = sqrt(dx*dx + dy*dy);
+		if (best < 0 || d < best_distance) {
+			best_distance = d;
+			best = i;
+		}
+	}
+	return best < 0 ? 0 : best;
+}
+
+static void usage(const char *argv0) {
+	fprintf(stderr, "usage: %s [-n WINDOWS] [-m MONITORS] [-r REPEAT]\n", argv0);
+	exit(1);
+}
+
+int main(int argc, char **argv) {
+	int opt;
+	while ((opt = getopt(argc, argv, "n:m:r:")) != -1) {
+		switch (opt) {
+		case 'n':
+			nwindows = strtoul(optarg, NULL, 0);
+			break;
+		case 'm':
+			nmonitors = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			nrepeat = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (nwindows < 1 || nmonitors < 1 || nrepeat < 1)
+		usage(argv[0]);
+
+	// Monitors in a row, alternating sizes
+	struct monitor *monitors = calloc(nmonitors, sizeof(*monitors));
+	int *results = calloc(nwindows, sizeof(int));
+	int *closest = calloc(nwindows, sizeof(int));
+	int (*rects)[4] = calloc(nwindows, sizeof(*rects));
+	if (!monitors || !results || !closest || !rects) {
+		fprintf(stderr, "%s: out of memory\n", argv[0]);
+		exit(1);
+	}
+	for (unsigned j = 0, x = 0; j < nmonitors; j++) {
+		monitors[j].x = x;
+		monitors[j].y = 0;
+		monitors[j].width = (j & 1) ? 1280 : 1920;
+		monitors[j].height = (j & 1) ? 1024 : 1080;
+		monitors[j].area = monitors[j].width * monitors[j].height;
+		x += monitors[j].width;
+	}
+
+	// Windows scattered over and beyond the monitors
+	srand(1);
+	for (unsigned i = 0; i < nwindows; i++) {
+		int x = rand() % (nmonitors * 1920 + 2000) - 1000;
+		int y = rand() % 3000 - 1000;
+		rects[i][0] = x;
+		rects[i][1] = y;
+		rects[i][2] = x + 50 + rand() % 1000;
+		rects[i][3] = y + 50 + rand() % 800;
+	}
+
+	unsigned sum = 0;
+	double start = now();
+	for (unsigned r = 0; r < nrepeat; r++) {
+		for (unsigned i = 0; i < nwindows; i++) {
+			results[i] = reference_monitor(monitors, nmonitors,
+						       rects[i][0], rects[i][1], rects[i][2], rects[i][3]);
+		}
+		sum += results[r % nwindows];
+	}
+	double scalar = now() - start;
+
+	start = now();
+	for (unsigned r = 0; r < nrepeat; r++) {
+		for (unsigned i = 0; i < nwindows; i++) {
+			closest[i] = monitor_closest(monitors, nmonitors, rects[i][0], rects[i][1],
+						     rects[i][2], rects[i][3], NULL);
+		}
+		sum += closest[r % nwindows];
+	}
+	double current = now() - start;
+
+	unsigned mismatches = 0;
+	for (unsigned i = 0; i < nwindows; i++) {
+		if (results[i] != closest[i])
+			mismatches++;
+	}
+
+	printf("%u windows x %u monitors, %u repeats (%u)\n", nwindows, nmonitors, nrepeat, sum);
+	printf("%-12s %10.1f ns/window\n", "scalar", scalar * 1e9 / ((double)nwindows * nrepeat));
+	printf("%-12s %10.1f ns/window\n", "closest", current * 1e9 / ((double)nwindows * nrepeat));
+	printf("%-12s %10u\n", "mismatches", mismatches);
+
+	free(rects);
+	free(closest);
+	free(results);
+	free(monitors);
+	return mismatches ? 1 : 0;
+}
@@ -0,0 +1,61 @@
+#!/bin/sh
+# evilwm - minimalist window manager for X11
+# Copyright (C) 1999-2025 Ciaran Anscomb <evilwm@6809.org.uk>
+# see README for license and other details.
+
+# Run the benchmark driver against evilwm on a private Xvfb display, then
+# report evilwm's own event latency statistics and peak memory use.
+#
+# Usage: run.sh EVILWM BENCH [BENCH OPTIONS]...
+
+EVILWM="${1:-./evilwm}"
+BENCH="${2:-bench/evilwm-bench}"
+shift 2
+BENCH_DISPLAY="${BENCH_DISPLAY:-:97}"
+
+statsfile=$(mktemp)
+xvfb_pid=
+wm_pid=
+
+cleanup() {
+	test -n "$wm_pid" && kill "$wm_pid" 2>/dev/null
+	test -n "$xvfb_pid" && kill "$xvfb_pid" 2>/dev/null
+	rm -f "$statsfile"
+}
+trap cleanup EXIT INT TERM
+
+Xvfb "$BENCH_DISPLAY" -screen 0 1280x1024x24 -nolisten tcp >/dev/null 2>&1 &
+xvfb_pid=$!
+i=0
+while ! test -e "/tmp/.X11-unix/X${BENCH_DISPLAY#:}"; do
+	i=$((i+1))
+	if test $i -gt 100; then
+		echo "$0: Xvfb failed to start" >&2
+		exit 1
+	fi
+	sleep 0.1
+done
+
+DISPLAY="$BENCH_DISPLAY" "$EVILWM" --statsfile "$statsfile" &
+wm_pid=$!
+
+DISPLAY="$BENCH_DISPLAY" "$BENCH" "$@" || exit 1
+
+# Ask evilwm for its statistics and wait for it to write them.  The file is
+# renamed into place once complete, so it is never read half written.
+kill -USR1 "$wm_pid"
+i=0
+while ! grep -q '^event ' "$statsfile" 2>/dev/null; do
+	i=$((i+1))
+	if test $i -gt 100; then
+		echo "$0: no statistics from evilwm" >&2
+		exit 1
+	fi
+	sleep 0.1
+done
+
+echo
+awk '$1 == "all" { printf "event latency p50 %s us, p99 %s us, max %s us over %s events\n", $6, $7, $8, $2 }' "$statsfile"
+awk '/^VmHWM:/ { printf "peak rss %s %s\n", $2, $3 }' "/proc/$wm_pid/status" 2>/dev/null
+echo
+cat "$statsfile"
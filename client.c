@@ -13,9 +13,6 @@
 #include <stdlib.h>
 #include <string.h>
 
-#ifdef HAVE_MATH_H
-#include <math.h>
-#endif
 
 #include <X11/X.h>
 #include <X11/Xlib.h>
@@ -29,15 +26,17 @@
 #include "display.h"
 #include "evilwm.h"
 #include "ewmh.h"
-#include "list.h"
 #include "log.h"
+#include "loop.h"
+#include "monitor.h"
 #include "screen.h"
+#include "stats.h"
 #include "util.h"
 
 // Client tracking information
-struct list *clients_tab_order = NULL;
-struct list *clients_mapping_order = NULL;
-struct list *clients_stacking_order = NULL;
+struct client_list clients_tab_order = { NULL, NULL, CLIENT_LINK_TAB };
+struct client_list clients_mapping_order = { NULL, NULL, CLIENT_LINK_MAPPING };
+struct client_list clients_stacking_order = { NULL, NULL, CLIENT_LINK_STACKING };
 struct client *current = NULL;
 
 // Get WM_NORMAL_HINTS property.  Populates appropriate parts of the client
@@ -46,14 +45,24 @@ struct client *current = NULL;
 
 long get_wm_normal_hints(struct client *c) {
 	long flags;
-	long dummy;
 	XSizeHints *size = XAllocSizeHints();
 
 	LOG_XENTER("XGetWMNormalHints(window=%lx)", (unsigned long)c->window);
-	XGetWMNormalHints(display.dpy, c->window, size, &dummy);
-	debug_wm_normal_hints(size);
+	get_size_hints(c->window, size);
 	LOG_XLEAVE();
 
+	flags = apply_wm_normal_hints(c, size);
+	XFree(size);
+	return flags;
+}
+
+// Update client size constraints from already fetched WM_NORMAL_HINTS.
+
+long apply_wm_normal_hints(struct client *c, XSizeHints *size) {
+	long flags;
+
+	debug_wm_normal_hints(size);
+
 	flags = size->flags;
 
 	if (flags & PMinSize) {
@@ -96,7 +105,6 @@ long get_wm_normal_hints(struct client *c) {
 	}
 	c->win_gravity = c->win_gravity_hint;
 
-	XFree(size);
 	return flags;
 }
 
@@ -117,99 +125,150 @@ void update_window_type_flags(struct client *c, unsigned type) {
 // Managed windows are all reparented, so most client operations act on the
 // parent window.
 
-// find_client() is used all over the place.  Return the client that has
-// specified window as either window or parent.  NULL if not found.
+// Both the client window and its parent are entered into a hash index that
+// maps window ID to client.  This is an open addressing table with linear
+// probing, kept at most half full.  Removal shifts any following entries in
+// the same run back into place, so no tombstones are needed.
 
-struct client *find_client(Window w) {
-	for (struct list *iter = clients_tab_order; iter; iter = iter->next) {
-		struct client *c = iter->data;
-		if (w == c->parent || w == c->window)
-			return c;
+#define CLIENT_INDEX_MIN_SIZE 64
+
+struct client_index_entry {
+	Window w;
+	struct client *c;
+};
+
+static struct client_index_entry *client_index = NULL;
+static unsigned client_index_size = 0;  // always a power of 2
+static unsigned client_index_count = 0;
+
+// Window IDs are allocated sequentially from a per-connection base, so mix
+// the bits up a little before masking.
+
+static unsigned window_hash(Window w) {
+	uint32_t h = (uint32_t)w;
+	h ^= h >> 16;
+	h *= 0x45d9f3b;
+	h ^= h >> 16;
+	return h;
+}
+
+static void client_index_insert(struct client_index_entry *table, unsigned size,
+				Window w, struct client *c) {
+	unsigned mask = size - 1;
+	unsigned i = window_hash(w) & mask;
+	while (table[i].w != None && table[i].w != w)
+		i = (i + 1) & mask;
+	table[i].w = w;
+	table[i].c = c;
+}
+
+// Add window to the index.  The table grows before it gets more than half
+// full, leaving room for one more entry (a client's parent window is added
+// after its application window).  Returns false only if there is no room at
+// all and the table could not be grown.
+
+_Bool client_index_add(Window w, struct client *c) {
+	if (w == None)
+		return 1;
+	if ((client_index_count + 2) * 2 > client_index_size) {
+		unsigned new_size = client_index_size ? client_index_size * 2 : CLIENT_INDEX_MIN_SIZE;
+		struct client_index_entry *new_index = calloc(new_size, sizeof(*new_index));
+		if (new_index) {
+			for (unsigned i = 0; i < client_index_size; i++) {
+				if (client_index[i].w != None)
+					client_index_insert(new_index, new_size, client_index[i].w, client_index[i].c);
+			}
+			free(client_index);
+			client_index = new_index;
+			client_index_size = new_size;
+		} else if (client_index_count + 1 >= client_index_size) {
+			return 0;
+		}
 	}
-	return NULL;
+	client_index_insert(client_index, client_index_size, w, c);
+	client_index_count++;
+	return 1;
 }
 
-static int imin(int a, int b) {
-	return (a < b) ? a : b;
+// Remove window from the index.
+
+void client_index_remove(Window w) {
+	if (w == None || !client_index)
+		return;
+	unsigned mask = client_index_size - 1;
+	unsigned i = window_hash(w) & mask;
+	while (client_index[i].w != w) {
+		if (client_index[i].w == None)
+			return;
+		i = (i + 1) & mask;
+	}
+	client_index_count--;
+	// Shift back any entries in the same run that would no longer be
+	// reachable from their home slot.
+	for (unsigned j = (i + 1) & mask; client_index[j].w != None; j = (j + 1) & mask) {
+		unsigned home = window_hash(client_index[j].w) & mask;
+		if (((j - home) & mask) >= ((j - i) & mask)) {
+			client_index[i] = client_index[j];
+			i = j;
+		}
+	}
+	client_index[i].w = None;
+	client_index[i].c = NULL;
 }
 
-static int imax(int a, int b) {
-	return (a > b) ? a : b;
+// find_client() is used all over the place.  Return the client that has
+// specified window as either window or parent.  NULL if not found.
+
+struct client *find_client(Window w) {
+	if (w == None || !client_index)
+		return NULL;
+	unsigned mask = client_index_size - 1;
+	for (unsigned i = window_hash(w) & mask; client_index[i].w != None; i = (i + 1) & mask) {
+		if (client_index[i].w == w)
+			return client_index[i].c;
+	}
+	return NULL;
 }
 
-// Determine which monitor to consider "closest" for the client.  This is
-// either largest intersection ratio or, if no intersection with any monitor
-// (ie not visible), closest mid points.
-//
-// Largest ratio should mean that if one monitor is a subset of another, a
-// window within it will be considered to be "closest" to the smaller monitor
-// for the purpose of maximising, etc.
+// Determine which monitor to consider "closest" for the client.  See
+// monitor.h for the criteria.  The result is cached until the client's
+// geometry or the screen's monitors change.
 //
 // 'intersects' is set to represent whether client intersects with any monitor.
 
 struct monitor *client_monitor(struct client *c, Bool *intersects) {
-	int cx1 = c->x - c->border;
-	int cy1 = c->y - c->border;
-	int cx2 = cx1 + c->width + c->border*2;
-	int cy2 = cy1 + c->height + c->border*2;
-	int cmidx = (cx1 + cx2)/2;
-	int cmidy = (cy1 + cy2)/2;
-
-	struct monitor *best = NULL;
-	Bool have_intersection = 0;
-	double best_area_ratio = 0.0;
-	double best_distance = 0.0;;
-
-	for (int i = 0; i < c->screen->nmonitors; i++) {
-		struct monitor *m = &c->screen->monitors[i];
-		int mx2 = m->x + m->width;
-		int my2 = m->y + m->height;
-
-		int iw = imax(0, imin(mx2, cx2) - imax(m->x, cx1));
-		int ih = imax(0, imin(my2, cy2) - imax(m->y, cy1));
-		int iarea = iw * ih;
-
-		// XXX if you're building on a platform without any floating
-		// point, you could consider simply returning the first monitor
-		// for which an intersection is found.
-
-		if (iarea > 0) {
-			// Found an intersection.  Higher ratio wins.
-			double iarea_ratio = (double)iarea / (double)m->area;
-			if (!have_intersection || iarea_ratio > best_area_ratio) {
-				have_intersection = 1;
-				best_area_ratio = iarea_ratio;
-				best = m;
-				continue;
-			}
+	struct screen *s = c->screen;
+	if (c->monitor_generation == s->monitor_generation
+	    && c->monitor_x == c->x && c->monitor_y == c->y
+	    && c->monitor_width == c->width && c->monitor_height == c->height
+	    && c->monitor_border == c->border) {
+		if (intersects) {
+			*intersects = c->monitor_intersects;
 		}
-
-		// Otherwise, any previous intersection trumps distance.
-		if (have_intersection)
-			continue;
-
-#ifdef HAVE_MATH_H
-		// No intersections yet, calculate distance between midpoints.
-		int mmidx = (m->x + mx2)/2;
-		int mmidy = (m->y + my2)/2;
-		int dx = abs(cmidx - mmidx);
-		int dy = abs(cmidy - mmidy);
-		double d = sqrt(dx*dx + dy*dy);
-
-		if (!best || d < best_distance) {
-			best_distance = d;
-			best = m;
-		}
-#endif
+		return &s->monitors[c->monitor];
 	}
 
-	if (!best) {
-		best = &c->screen->monitors[0];
-	}
+	int x1 = c->x - c->border;
+	int y1 = c->y - c->border;
+	int x2 = x1 + c->width + c->border*2;
+	int y2 = y1 + c->height + c->border*2;
+	int have_intersection;
+	int best = monitor_closest(s->monitors, s->nmonitors, x1, y1, x2, y2,
+				   &have_intersection);
+
+	c->monitor = best;
+	c->monitor_intersects = have_intersection;
+	c->monitor_generation = s->monitor_generation;
+	c->monitor_x = c->x;
+	c->monitor_y = c->y;
+	c->monitor_width = c->width;
+	c->monitor_height = c->height;
+	c->monitor_border = c->border;
+
 	if (intersects) {
 		*intersects = have_intersection;
 	}
-	return best;
+	return &s->monitors[best];
 }
 
 // "Hides" the client (unmaps and flags it as iconified).  Used to simulate
@@ -234,8 +293,9 @@ void client_show(struct client *c) {
 void client_raise(struct client *c) {
 	LOG_XDEBUG("XRaiseWindow(window=%lx,parent=%lx)\n", (unsigned long)c->window, (unsigned long)c->parent);
 	XRaiseWindow(display.dpy, c->parent);
-	clients_stacking_order = list_to_tail(clients_stacking_order, c);
-	ewmh_set_net_client_list_stacking(c->screen);
+	client_list_to_tail(&clients_stacking_order, c);
+	client_list_to_tail(screen_vdesk_clients(c->screen, c->vdesk), c);
+	ewmh_client_list_raise(c);
 }
 
 // Lower client.  Maintains clients_stacking_order list and EWMH hints.
@@ -243,8 +303,9 @@ void client_raise(struct client *c) {
 void client_lower(struct client *c) {
 	LOG_XDEBUG("XLowerWindow(window=%lx,parent=%lx)\n", (unsigned long)c->window, (unsigned long)c->parent);
 	XLowerWindow(display.dpy, c->parent);
-	clients_stacking_order = list_to_head(clients_stacking_order, c);
-	ewmh_set_net_client_list_stacking(c->screen);
+	client_list_to_head(&clients_stacking_order, c);
+	client_list_to_head(screen_vdesk_clients(c->screen, c->vdesk), c);
+	ewmh_client_list_lower(c);
 }
 
 // Set window state.  This is either NormalState (visible), IconicState
@@ -260,7 +321,7 @@ void set_wm_state(struct client *c, int state) {
 
 // Inform client of changed geometry by sending ConfigureNotify to its window.
 
-void send_config(struct client *c) {
+static void send_config_event(struct client *c) {
 	XEvent ev = {
 		.xconfigure = {
 			.type = ConfigureNotify,
@@ -278,6 +339,51 @@ void send_config(struct client *c) {
 	XSendEvent(display.dpy, c->window, False, StructureNotifyMask, &ev);
 }
 
+static void config_timer_expired(void *data) {
+	struct client *c = data;
+	c->config_timer = 0;
+	client_flush_config(c);
+}
+
+static void cancel_config_timer(struct client *c) {
+	if (c->config_timer) {
+		loop_timer_cancel(c->config_timer);
+		c->config_timer = 0;
+	}
+}
+
+// Clients may do a lot of work in response to ConfigureNotify, so during
+// interactive moves, if "configdelay" is set, only send one per that interval.
+// The latest is held until the interval is up, or client_flush_config().
+
+void send_config(struct client *c) {
+	if (c->interactive && option.configdelay > 0) {
+		long long now = get_time_us();
+		long long due_us = c->config_sent_us + option.configdelay * 1000LL;
+		if (now < due_us) {
+			c->config_pending = 1;
+			if (!c->config_timer)
+				c->config_timer = loop_timer_add(due_us, config_timer_expired, c);
+			return;
+		}
+		c->config_sent_us = now;
+	}
+	cancel_config_timer(c);
+	c->config_pending = 0;
+	send_config_event(c);
+}
+
+// Send any ConfigureNotify held back by send_config().
+
+void client_flush_config(struct client *c) {
+	cancel_config_timer(c);
+	if (!c->config_pending)
+		return;
+	c->config_pending = 0;
+	c->config_sent_us = get_time_us();
+	send_config_event(c);
+}
+
 // Offset client to show border according to window's gravity.  e.g.,
 // SouthEastGravity will offset the client up and left by the supplied border
 // width.
@@ -355,12 +461,27 @@ void select_client(struct client *c) {
 		ewmh_set_net_wm_state(c);
 }
 
+// Add a client to the list of clients on its vdesk (or the fixed list) on its
+// screen.  The list is kept in stacking order, so insert it below the next
+// client above it that shares the list.
+
+void client_vdesk_link(struct client *c) {
+	struct client *above = client_list_next(&clients_stacking_order, c);
+	while (above && (above->screen != c->screen || above->vdesk != c->vdesk))
+		above = client_list_next(&clients_stacking_order, above);
+	client_list_insert_before(screen_vdesk_clients(c->screen, c->vdesk), above, c);
+}
+
 // Move a client to a specific vdesk.  If that means it should no longer be
 // visible, hide it.
 
 void client_to_vdesk(struct client *c, unsigned vdesk) {
 	if (valid_vdesk(vdesk)) {
-		c->vdesk = vdesk;
+		if (vdesk != c->vdesk) {
+			client_list_remove(screen_vdesk_clients(c->screen, c->vdesk), c);
+			c->vdesk = vdesk;
+			client_vdesk_link(c);
+		}
 		if (c->vdesk == c->screen->vdesk || c->vdesk == VDESK_FIXED) {
 			client_show(c);
 		} else {
@@ -371,19 +492,18 @@ void client_to_vdesk(struct client *c, unsigned vdesk) {
 	}
 }
 
-// Stop managing a client.  Undoes any transformations that were made when
-// managing it.
+// Undo any transformations that were made when managing a client, and unlink
+// it from everything except the EWMH client lists.  Does not free it.
 
-void remove_client(struct client *c) {
-	LOG_ENTER("remove_client(window=%lx, %s)", (unsigned long)c->window, c->remove ? "withdrawing" : "wm quitting");
+static void unmanage_client(struct client *c) {
+	cancel_config_timer(c);
 
-	// Grab the server so any X errors are guaranteed to come from our actions.
-	XGrabServer(display.dpy);
-
-	// Flag to ignore any X errors we trigger.  The window may well already
-	// have been deleted from the server, so anything we try to do to it
-	// here would raise one.
-	ignore_xerror = 1;
+	// The window may well already have been deleted from the server, so
+	// anything we try to do to it here could raise an X error.  Tell the
+	// error handler to expect them.  The server isn't grabbed, and we
+	// don't wait for the requests to be processed: errors arriving later
+	// are matched by serial number.
+	xerror_expect_begin(c->window);
 
 	// ICCCM 4.1.3.1
 	// "When the window is withdrawn, the window manager will either change
@@ -429,16 +549,12 @@ void remove_client(struct client *c) {
 	}
 
 	// Remove from the client lists
-	clients_tab_order = list_delete(clients_tab_order, c);
-	clients_mapping_order = list_delete(clients_mapping_order, c);
-	clients_stacking_order = list_delete(clients_stacking_order, c);
-
-	// If the wm is quitting, we'll remove the client list properties
-	// soon enough, otherwise, update them:
-	if (c->remove) {
-		ewmh_set_net_client_list(c->screen);
-		ewmh_set_net_client_list_stacking(c->screen);
-	}
+	client_index_remove(c->window);
+	client_index_remove(c->parent);
+	client_list_remove(&clients_tab_order, c);
+	client_list_remove(&clients_mapping_order, c);
+	client_list_remove(&clients_stacking_order, c);
+	client_list_remove(screen_vdesk_clients(c->screen, c->vdesk), c);
 
 	// Deselect if this client were previously selected
 	if (current == c) {
@@ -447,23 +563,143 @@ void remove_client(struct client *c) {
 		// _NET_ACTIVE_WINDOW from screen if necessary.
 		ewmh_set_net_wm_state(c);
 	}
-	free(c);
+
+	xerror_expect_end();
+}
 
 #ifdef DEBUG
-	{
-		int i = 0;
-		for (struct list *iter = clients_tab_order; iter; iter = iter->next)
-			i++;
-		LOG_DEBUG("free(), window count now %d\n", i);
-	}
+static void debug_window_count(void) {
+	int i = 0;
+	for (struct client *ci = clients_tab_order.head; ci; ci = client_list_next(&clients_tab_order, ci))
+		i++;
+	LOG_DEBUG("free(), window count now %d\n", i);
+}
+#else
+# define debug_window_count() do { } while (0)
 #endif
 
-	XUngrabServer(display.dpy);
-	XSync(display.dpy, False);
-	ignore_xerror = 0;
+// Stop managing a client.  Undoes any transformations that were made when
+// managing it.
+
+void remove_client(struct client *c) {
+	LOG_ENTER("remove_client(window=%lx, %s)", (unsigned long)c->window, c->remove ? "withdrawing" : "wm quitting");
+
+	unmanage_client(c);
+
+	// Remove from the EWMH client lists.  If the wm is quitting, the
+	// properties themselves will be removed soon enough.
+	ewmh_client_list_remove(c);
+
+	free(c);
+	debug_window_count();
+	LOG_LEAVE();
+}
+
+// Stop managing all clients flagged for removal.  Each is withdrawn as by
+// remove_client(), but the EWMH client list arrays are compacted once per
+// screen rather than searched once per client.  None of this waits on the
+// server, so however many windows closed, no round trip is made here.
+
+void remove_flagged_clients(void) {
+	struct client *c, *nc;
+	unsigned n = 0;
+
+	LOG_ENTER("remove_flagged_clients()");
+	for (c = clients_tab_order.head; c; c = nc) {
+		nc = client_list_next(&clients_tab_order, c);
+		if (!c->remove)
+			continue;
+		LOG_DEBUG("withdrawing window=%lx\n", (unsigned long)c->window);
+		unmanage_client(c);
+		free(c);
+		n++;
+	}
+	if (n) {
+		for (int i = 0; i < display.nscreens; i++)
+			ewmh_client_list_purge(&display.screens[i]);
+		debug_window_count();
+	}
 	LOG_LEAVE();
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// Client list handling.  Each list follows one of the sets of links embedded
+// in the client structure.
+
+void client_list_prepend(struct client_list *l, struct client *c) {
+	struct client_link *link = &c->links[l->link];
+	link->prev = NULL;
+	link->next = l->head;
+	if (l->head)
+		client_list_prev(l, l->head) = c;
+	else
+		l->tail = c;
+	l->head = c;
+}
+
+void client_list_append(struct client_list *l, struct client *c) {
+	struct client_link *link = &c->links[l->link];
+	link->prev = l->tail;
+	link->next = NULL;
+	if (l->tail)
+		client_list_next(l, l->tail) = c;
+	else
+		l->head = c;
+	l->tail = c;
+}
+
+// Insert client before another already in the list, or at the tail if
+// 'before' is NULL.
+
+void client_list_insert_before(struct client_list *l, struct client *before, struct client *c) {
+	if (!before) {
+		client_list_append(l, c);
+		return;
+	}
+	struct client_link *link = &c->links[l->link];
+	link->prev = client_list_prev(l, before);
+	link->next = before;
+	if (link->prev)
+		client_list_next(l, link->prev) = c;
+	else
+		l->head = c;
+	client_list_prev(l, before) = c;
+}
+
+// Unlink client from list.  Does nothing if the client isn't in the list.
+
+void client_list_remove(struct client_list *l, struct client *c) {
+	struct client_link *link = &c->links[l->link];
+	if (link->prev)
+		client_list_next(l, link->prev) = link->next;
+	else if (l->head == c)
+		l->head = link->next;
+	else
+		return;
+	if (link->next)
+		client_list_prev(l, link->next) = link->prev;
+	else
+		l->tail = link->prev;
+	link->prev = link->next = NULL;
+}
+
+void client_list_to_head(struct client_list *l, struct client *c) {
+	if (!c || l->head == c)
+		return;
+	client_list_remove(l, c);
+	client_list_prepend(l, c);
+}
+
+void client_list_to_tail(struct client_list *l, struct client *c) {
+	if (!c || l->tail == c)
+		return;
+	client_list_remove(l, c);
+	client_list_append(l, c);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
 // Delete a window.  Sends WM_DELETE_WINDOW to a client if that protocol is
 // found to be supported.  Otherwise (or if forced by setting kill_client), use
 // XKillClient (terminates its connection to the server).
@@ -473,7 +709,7 @@ void send_wm_delete(struct client *c, int kill_client) {
 	int n;
 	Atom *protocols;
 
-	if (!kill_client && XGetWMProtocols(display.dpy, c->window, &protocols, &n)) {
+	if (!kill_client && get_wm_protocols(c->window, &protocols, &n)) {
 		for (int i = 0; i < n; i++)
 			if (protocols[i] == X_ATOM(WM_DELETE_WINDOW))
 				delete_supported = 1;
@@ -512,6 +748,7 @@ void set_shape(struct client *c) {
 	// Previous method (more than one rectangle returned from
 	// XShapeGetRectangles) worked _most_ of the time.
 
+	stats_round_trip();
 	if (XShapeQueryExtents(display.dpy, c->window, &bounding_shaped, &i, &i,
 				&u, &u, &b, &i, &i, &u, &u) && bounding_shaped) {
 		LOG_DEBUG("%d shape extents\n", bounding_shaped);
@@ -547,7 +784,7 @@ void update_info_window(struct client *c) {
                 (c->height-c->base_height)/height_inc, c->x, c->y);
         iwinw = XTextWidth(display.font, buf, strlen(buf)) + 2;
         iwinh = display.font->max_bounds.ascent + display.font->max_bounds.descent;
-        XFetchName(display.dpy, c->window, &name);
+        fetch_name(c->window, &name);
         if (name) {
                 namew = XTextWidth(display.font, name, strlen(name));
                 if (namew > iwinw)
@@ -11,7 +11,10 @@
 #ifndef EVILWM_CLIENT_H_
 #define EVILWM_CLIENT_H_
 
-struct list;
+#include <X11/X.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
 struct screen;
 struct monitor;
 
@@ -27,6 +30,46 @@ struct monitor;
 #define VDESK_MAX_ROW   (option.vdeskrows - 1)
 #define valid_vdesk(v) ((v) == VDESK_FIXED || (v) < option.vdeskcolumns * option.vdeskrows)
 
+// Geometry remembered for a client under a particular layout of monitors, so
+// that it can be restored if that layout reappears.  Only the most recent few
+// layouts are remembered for each client.
+
+#define NUM_CLIENT_LAYOUTS 4
+
+struct client_layout {
+	unsigned long layout;  // hash of monitor geometries; 0 = unused
+	int x, y, width, height;
+	int oldx, oldy, oldw, oldh;
+	int border;
+};
+
+// Clients are kept in several orderings at once.  Rather than wrapping each
+// client in separately allocated list elements, every client embeds one set
+// of links per ordering, so moving or removing a client is O(1) and never
+// allocates.
+
+enum client_link_id {
+	CLIENT_LINK_TAB,       // clients_tab_order
+	CLIENT_LINK_MAPPING,   // clients_mapping_order
+	CLIENT_LINK_STACKING,  // clients_stacking_order
+	CLIENT_LINK_VDESK,     // per-screen vdesk or fixed client list
+	NUM_CLIENT_LINKS
+};
+
+struct client_link {
+	struct client *prev;
+	struct client *next;
+};
+
+struct client_list {
+	struct client *head;
+	struct client *tail;
+	enum client_link_id link;  // which of each client's links to follow
+};
+
+#define client_list_next(l, c) ((c)->links[(l)->link].next)
+#define client_list_prev(l, c) ((c)->links[(l)->link].prev)
+
 struct client {
 	Window window;  // actual application window
 	Window parent;  // parent window that we control
@@ -51,12 +94,32 @@ struct client {
 	// Old border width - only used to restore when quitting
 	int old_border;
 
-	// Old monitor offset as proportion of monitor geometry
+	// Old monitor offset as proportion of monitor geometry, and index of
+	// that monitor in screen's old_monitors
 	double mon_offx, mon_offy;
+	int mon_old;
+
+	// Geometry under recent monitor layouts, most recent first
+	struct client_layout layouts[NUM_CLIENT_LAYOUTS];
+
+	// Closest monitor, as last found by client_monitor().  Valid while
+	// the client's geometry and screen's monitor_generation are as noted.
+	int monitor;
+	int monitor_intersects;
+	unsigned monitor_generation;  // 0 if never found
+	int monitor_x, monitor_y;
+	int monitor_width, monitor_height, monitor_border;
 
 	// Flag set when we need to remove client from management
 	int remove;
 
+	// Set while the user is interactively moving the client, when
+	// synthetic ConfigureNotify events may be deferred (see send_config())
+	_Bool interactive;
+	_Bool config_pending;
+	long long config_sent_us;
+	unsigned config_timer;  // loop timer id for the held ConfigureNotify
+
 	// Various window metadata determined by examining properties
 	int min_width, min_height;
 	int max_width, max_height;
@@ -65,12 +128,15 @@ struct client {
 	int win_gravity_hint;
 	int win_gravity;
 	int is_dock;
+
+	// Links for each client ordering
+	struct client_link links[NUM_CLIENT_LINKS];
 };
 
 // Client tracking information
-extern struct list *clients_tab_order;
-extern struct list *clients_mapping_order;
-extern struct list *clients_stacking_order;
+extern struct client_list clients_tab_order;       // most recently used first
+extern struct client_list clients_mapping_order;   // order first managed
+extern struct client_list clients_stacking_order;  // bottom to top
 extern struct client *current;
 
 #define is_fixed(c) (c->vdesk == VDESK_FIXED)
@@ -78,7 +144,9 @@ extern struct client *current;
 // client_new.c: newly manage a window
 
 void client_manage_new(Window w, struct screen *s);
+unsigned client_manage_existing(struct screen *s, Window *wins, unsigned nwins);
 long get_wm_normal_hints(struct client *c);
+long apply_wm_normal_hints(struct client *c, XSizeHints *size);
 void get_window_type(struct client *c);
 void update_window_type_flags(struct client *c, unsigned type);
 
@@ -95,6 +163,8 @@ void client_select_next(void);
 // client.c: various other client functions
 
 struct client *find_client(Window w);
+_Bool client_index_add(Window w, struct client *c);
+void client_index_remove(Window w);
 struct monitor *client_monitor(struct client *c, Bool *intersects);
 void client_hide(struct client *c);
 void client_show(struct client *c);
@@ -102,10 +172,20 @@ void client_raise(struct client *c);
 void client_lower(struct client *c);
 void client_gravitate(struct client *c, int bw);
 void select_client(struct client *c);
+void client_vdesk_link(struct client *c);
 void client_to_vdesk(struct client *c, unsigned vdesk);
 void remove_client(struct client *c);
+void remove_flagged_clients(void);
+
+void client_list_prepend(struct client_list *l, struct client *c);
+void client_list_append(struct client_list *l, struct client *c);
+void client_list_insert_before(struct client_list *l, struct client *before, struct client *c);
+void client_list_remove(struct client_list *l, struct client *c);
+void client_list_to_head(struct client_list *l, struct client *c);
+void client_list_to_tail(struct client_list *l, struct client *c);
 
 void send_config(struct client *c);
+void client_flush_config(struct client *c);
 void send_wm_delete(struct client *c, int kill_client);
 void set_wm_state(struct client *c, int state);
 void set_shape(struct client *c);
@@ -13,63 +13,121 @@
 #include <string.h>
 
 #include <X11/X.h>
+#include <X11/Xatom.h>
 #include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#ifdef XSYNC
+#include <X11/extensions/sync.h>
+#endif
 
 #include "bind.h"
 #include "client.h"
 #include "display.h"
 #include "evilwm.h"
 #include "ewmh.h"
-#include "list.h"
+#include "loop.h"
 #include "screen.h"
+#include "stats.h"
 #include "util.h"
+#include "xalloc.h"
 
 #define SPACE 3
 
-// Use the inverting graphics context to draw an outline for the client.
-// Drawing it a second time will erase it.  If INFOBANNER_MOVERESIZE is
-// defined, the information window is shown for the duration (but this can be
-// slow on old X servers).
+// Outline shown while moving or resizing a client when not doing so "solidly".
+// It is built from four thin override-redirect windows, so nothing needs to be
+// drawn on the root window, and the X server needn't be grabbed.  If
+// INFOBANNER_MOVERESIZE is defined, the information window is shown for the
+// duration (but this can be slow on old X servers), otherwise a label shows
+// the client geometry in its bottom-right corner.
+
+static void update_outline(struct client *c) {
+	struct screen *s = c->screen;
+	int x = c->x - c->border;
+	int y = c->y - c->border;
+	int w = c->width + 2*c->border;
+	int h = c->height + 2*c->border;
+
+	XMoveResizeWindow(display.dpy, s->outline[0], x, y, w, 1);
+	XMoveResizeWindow(display.dpy, s->outline[1], x, y + h - 1, w, 1);
+	XMoveResizeWindow(display.dpy, s->outline[2], x, y, 1, h);
+	XMoveResizeWindow(display.dpy, s->outline[3], x + w - 1, y, 1, h);
 
-static void draw_outline(struct client *c) {
 #ifndef INFOBANNER_MOVERESIZE
 	char buf[27];
 	int width_inc = c->width_inc, height_inc = c->height_inc;
+	snprintf(buf, sizeof(buf), "%dx%d+%d+%d", (c->width-c->base_width)/width_inc,
+			(c->height-c->base_height)/height_inc, c->x, c->y);
+	int lw = XTextWidth(display.font, buf, strlen(buf)) + 2;
+	int lh = display.font->max_bounds.ascent + display.font->max_bounds.descent;
+	XMoveResizeWindow(display.dpy, s->outline_label,
+			  c->x + c->width - lw - SPACE,
+			  c->y + c->height - lh - SPACE, lw, lh);
+	XClearWindow(display.dpy, s->outline_label);
+	XDrawString(display.dpy, s->outline_label, s->invert_gc,
+		    1, display.font->max_bounds.ascent, buf, strlen(buf));
 #endif
+}
 
-	XDrawRectangle(display.dpy, c->screen->root, c->screen->invert_gc,
-		c->x - c->border, c->y - c->border,
-		c->width + 2*c->border-1, c->height + 2*c->border-1);
-
+static void show_outline(struct client *c) {
+	struct screen *s = c->screen;
+	for (int i = 0; i < 4; i++)
+		XMapRaised(display.dpy, s->outline[i]);
 #ifndef INFOBANNER_MOVERESIZE
-	snprintf(buf, sizeof(buf), "%dx%d+%d+%d", (c->width-c->base_width)/width_inc,
-			(c->height-c->base_height)/height_inc, c->x, c->y);
-	XDrawString(display.dpy, c->screen->root, c->screen->invert_gc,
-		c->x + c->width - XTextWidth(display.font, buf, strlen(buf)) - SPACE,
-		c->y + c->height - SPACE,
-		buf, strlen(buf));
+	XMapRaised(display.dpy, s->outline_label);
 #endif
+	update_outline(c);
 }
 
-static int absmin(int a, int b) {
-	if (abs(a) < abs(b))
-		return a;
-	return b;
+static void hide_outline(struct client *c) {
+	struct screen *s = c->screen;
+	for (int i = 0; i < 4; i++)
+		XUnmapWindow(display.dpy, s->outline[i]);
+#ifndef INFOBANNER_MOVERESIZE
+	XUnmapWindow(display.dpy, s->outline_label);
+#endif
 }
 
-// Snap a client to the edges of other clients (if on same screen, and visible)
-// or to the screen border.
+// Edges that a dragged client may snap to.  These are collected once at the
+// start of a drag: nothing else is processed while it's in progress, so the
+// other clients can't move.
+//
+// Each edge position is stored relative to the point on the dragged client it
+// would align with, so that for every edge, the distance to snap is simply
+// "pos" minus the client's x (or y) coordinate.  Arrays are sorted by
+// position, so only edges within snapping distance need be examined.
+
+struct snap_edge {
+	int pos;     // snap position for client's x (or y)
+	int lo, hi;  // only applies while client's y (or x) lies in this range
+};
+
+struct snap_index {
+	unsigned nedges;  // number of edges in each array
+	struct snap_edge *x_edges;
+	struct snap_edge *y_edges;
+};
+
+static int compare_snap_edges(const void *a, const void *b) {
+	const struct snap_edge *ea = a;
+	const struct snap_edge *eb = b;
+	return (ea->pos > eb->pos) - (ea->pos < eb->pos);
+}
 
-static void snap_client(struct client *c, struct monitor *monitor) {
-	int dx, dy;
-	int dpy_width = monitor->width;
-	int dpy_height = monitor->height;
+// Collect the edges of other clients visible on the same screen.
 
-	// Snap to other windows
+static void snap_index_init(struct snap_index *si, struct client *c) {
+	unsigned n = 0;
+	si->nedges = 0;
+	si->x_edges = si->y_edges = NULL;
+	if (!option.snap)
+		return;
+	for (struct client *ci = clients_tab_order.head; ci; ci = client_list_next(&clients_tab_order, ci))
+		n++;
+	si->x_edges = xmalloc(4 * n * sizeof(struct snap_edge));
+	si->y_edges = xmalloc(4 * n * sizeof(struct snap_edge));
 
-	dx = dy = option.snap;
-	for (struct list *iter = clients_tab_order; iter; iter = iter->next) {
-		struct client *ci = iter->data;
+	for (struct client *ci = clients_tab_order.head; ci; ci = client_list_next(&clients_tab_order, ci)) {
 		if (ci == c)
 			continue;
 		if (ci->screen != c->screen)
@@ -78,19 +136,79 @@ static void snap_client(struct client *c, struct monitor *monitor) {
 			continue;
 		if (ci->is_dock && !c->screen->docks_visible)
 			continue;
-		if (ci->y - ci->border - c->border - c->height - c->y <= option.snap && c->y - c->border - ci->border - ci->height - ci->y <= option.snap) {
-			dx = absmin(dx, ci->x + ci->width - c->x + c->border + ci->border);
-			dx = absmin(dx, ci->x + ci->width - c->x - c->width);
-			dx = absmin(dx, ci->x - c->x - c->width - c->border - ci->border);
-			dx = absmin(dx, ci->x - c->x);
-		}
-		if (ci->x - ci->border - c->border - c->width - c->x <= option.snap && c->x - c->border - ci->border - ci->width - ci->x <= option.snap) {
-			dy = absmin(dy, ci->y + ci->height - c->y + c->border + ci->border);
-			dy = absmin(dy, ci->y + ci->height - c->y - c->height);
-			dy = absmin(dy, ci->y - c->y - c->height - c->border - ci->border);
-			dy = absmin(dy, ci->y - c->y);
+
+		// Horizontal snapping applies while the clients overlap
+		// vertically (give or take the snap distance), and vice versa.
+		int ylo = ci->y - ci->border - c->border - c->height - option.snap;
+		int yhi = ci->y + ci->border + c->border + ci->height + option.snap;
+		int xlo = ci->x - ci->border - c->border - c->width - option.snap;
+		int xhi = ci->x + ci->border + c->border + ci->width + option.snap;
+
+		struct snap_edge *xe = &si->x_edges[si->nedges];
+		struct snap_edge *ye = &si->y_edges[si->nedges];
+		// Outside edges abutting
+		xe[0].pos = ci->x + ci->width + c->border + ci->border;
+		xe[1].pos = ci->x - c->width - c->border - ci->border;
+		ye[0].pos = ci->y + ci->height + c->border + ci->border;
+		ye[1].pos = ci->y - c->height - c->border - ci->border;
+		// Inside edges aligned
+		xe[2].pos = ci->x + ci->width - c->width;
+		xe[3].pos = ci->x;
+		ye[2].pos = ci->y + ci->height - c->height;
+		ye[3].pos = ci->y;
+		for (int i = 0; i < 4; i++) {
+			xe[i].lo = ylo;
+			xe[i].hi = yhi;
+			ye[i].lo = xlo;
+			ye[i].hi = xhi;
 		}
+		si->nedges += 4;
+	}
+
+	qsort(si->x_edges, si->nedges, sizeof(struct snap_edge), compare_snap_edges);
+	qsort(si->y_edges, si->nedges, sizeof(struct snap_edge), compare_snap_edges);
+}
+
+static void snap_index_free(struct snap_index *si) {
+	free(si->x_edges);
+	free(si->y_edges);
+}
+
+// Find the smallest offset from v to an edge that applies at w.  Returns
+// option.snap if none are close enough.
+
+static int snap_nearest(const struct snap_edge *edges, unsigned nedges, int v, int w) {
+	int d = option.snap;
+	// Binary search for first edge within snapping distance
+	unsigned lo = 0, hi = nedges;
+	while (lo < hi) {
+		unsigned mid = lo + (hi - lo) / 2;
+		if (edges[mid].pos <= v - option.snap)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	for (unsigned i = lo; i < nedges && edges[i].pos < v + option.snap; i++) {
+		if (w < edges[i].lo || w > edges[i].hi)
+			continue;
+		if (abs(edges[i].pos - v) < abs(d))
+			d = edges[i].pos - v;
 	}
+	return d;
+}
+
+// Snap a client to the edges of other clients (if on same screen, and visible)
+// or to the screen border.
+
+static void snap_client(struct client *c, struct monitor *monitor, const struct snap_index *si) {
+	int dx, dy;
+	int dpy_width = monitor->width;
+	int dpy_height = monitor->height;
+
+	// Snap to other windows
+
+	dx = snap_nearest(si->x_edges, si->nedges, c->x, c->y);
+	dy = snap_nearest(si->y_edges, si->nedges, c->y, c->x);
 	if (abs(dx) < option.snap)
 		c->x += dx;
 	if (abs(dy) < option.snap)
@@ -139,12 +257,182 @@ static void recalculate_sweep(struct client *c, int x1, int y1, int x2, int y2,
 	}
 }
 
+// Predicate function for use with XCheckIfEvent.
+//
+// Matches motion events queued ahead of any button press or release, so that
+// skipping motion never reorders it with respect to button events.
+
+static Bool predicate_motion(Display *dummy, XEvent *ev, XPointer arg) {
+	(void)dummy;
+	_Bool *barrier = (_Bool *)arg;
+	if (*barrier)
+		return False;
+	if (ev->type == ButtonPress || ev->type == ButtonRelease) {
+		*barrier = 1;
+		return False;
+	}
+	return ev->type == MotionNotify;
+}
+
+// Replace a motion event with the latest one already queued.  Fast mice can
+// generate far more motion than is useful to act on.
+
+static void compress_motion(XEvent *ev) {
+	XEvent next;
+	for (;;) {
+		_Bool barrier = 0;
+		if (!XCheckIfEvent(display.dpy, &next, predicate_motion, (XPointer)&barrier))
+			break;
+		*ev = next;
+		stats_count(motion_coalesced, 1);
+	}
+}
+
+// How long to wait for a client to acknowledge a _NET_WM_SYNC_REQUEST before
+// resizing it anyway.
+#define SYNC_TIMEOUT_US (100000)
+
+// Pacing for solid resizes.  Resizing can be expensive for a client, so a new
+// size is only applied once it has caught up with the last.  For clients
+// supporting _NET_WM_SYNC_REQUEST, that's when it updates its sync counter.
+// Otherwise, resizes are limited to "dragrate" per second.
+
+struct resize_pace {
+	long long frame_us;  // minimum interval if not synchronised
+	long long next_us;   // earliest time for next resize
+#ifdef XSYNC
+	XSyncAlarm alarm;    // triggers when client updates its counter
+	XSyncValue value;    // last value sent to client
+	_Bool waiting;       // awaiting client's update
+#endif
+};
+
+#ifdef XSYNC
+
+// Set up an alarm on the client's sync counter, if it has one.
+
+static void resize_sync_init(struct client *c, struct resize_pace *p) {
+	p->alarm = None;
+	p->waiting = 0;
+	if (!display.have_xsync)
+		return;
+
+	Atom *protocols;
+	int n;
+	_Bool supported = 0;
+	if (get_wm_protocols(c->window, &protocols, &n)) {
+		for (int i = 0; i < n; i++) {
+			if (protocols[i] == X_ATOM(_NET_WM_SYNC_REQUEST))
+				supported = 1;
+		}
+		XFree(protocols);
+	}
+	if (!supported)
+		return;
+
+	unsigned long nitems;
+	unsigned long *counter = get_property(c->window, X_ATOM(_NET_WM_SYNC_REQUEST_COUNTER), XA_CARDINAL, &nitems);
+	if (!counter)
+		return;
+	XSyncAlarmAttributes aa;
+	aa.trigger.counter = nitems > 0 ? counter[0] : None;
+	XFree(counter);
+	if (aa.trigger.counter == None)
+		return;
+
+	stats_round_trip();
+	if (!XSyncQueryCounter(display.dpy, aa.trigger.counter, &p->value))
+		return;
+	// Wait for the value the first request will ask for, so that the
+	// alarm does not trigger on creation.
+	XSyncValue one;
+	int overflow;
+	XSyncIntToValue(&one, 1);
+	aa.trigger.value_type = XSyncAbsolute;
+	aa.trigger.test_type = XSyncPositiveComparison;
+	XSyncValueAdd(&aa.trigger.wait_value, p->value, one, &overflow);
+	XSyncIntToValue(&aa.delta, 0);
+	aa.events = True;
+	p->alarm = XSyncCreateAlarm(display.dpy, XSyncCACounter | XSyncCAValueType
+				    | XSyncCAValue | XSyncCATestType | XSyncCADelta
+				    | XSyncCAEvents, &aa);
+}
+
+// Ask the client to update its counter once it has handled the resize about
+// to be sent.
+
+static void resize_sync_request(struct client *c, struct resize_pace *p) {
+	XSyncValue one;
+	int overflow;
+	XSyncIntToValue(&one, 1);
+	XSyncValueAdd(&p->value, p->value, one, &overflow);
+
+	XEvent ev = {
+		.xclient = {
+			.type = ClientMessage,
+			.window = c->window,
+			.message_type = X_ATOM(WM_PROTOCOLS),
+			.format = 32,
+			.data.l = { X_ATOM(_NET_WM_SYNC_REQUEST), CurrentTime,
+				    XSyncValueLow32(p->value),
+				    XSyncValueHigh32(p->value), 0 }
+		}
+	};
+	XSendEvent(display.dpy, c->window, False, NoEventMask, &ev);
+
+	// The alarm is inactive once it has triggered, so is rearmed with the
+	// new value each time.
+	XSyncAlarmAttributes aa;
+	aa.trigger.wait_value = p->value;
+	XSyncChangeAlarm(display.dpy, p->alarm, XSyncCAValue, &aa);
+	p->waiting = 1;
+}
+
+// Note any acknowledgement from the client.
+
+static void resize_sync_check(struct resize_pace *p) {
+	XEvent ev;
+	while (XCheckTypedEvent(display.dpy, display.xsync_event_base + XSyncAlarmNotify, &ev)) {
+		XSyncAlarmNotifyEvent *ae = (XSyncAlarmNotifyEvent *)&ev;
+		if (ae->alarm == p->alarm && p->waiting
+		    && XSyncValueGreaterOrEqual(ae->counter_value, p->value)) {
+			p->waiting = 0;
+			p->next_us = 0;
+		}
+	}
+}
+
+#endif
+
+// Microseconds until the next solid resize may be applied.
+
+static long long resize_delay(struct resize_pace *p) {
+#ifdef XSYNC
+	if (p->waiting)
+		resize_sync_check(p);
+#endif
+	return p->next_us - get_time_us();
+}
+
+// Apply client's current geometry during a solid resize.
+
+static void resize_apply(struct client *c, struct resize_pace *p) {
+	p->next_us = get_time_us() + p->frame_us;
+#ifdef XSYNC
+	if (p->alarm != None) {
+		resize_sync_request(c, p);
+		p->next_us = get_time_us() + SYNC_TIMEOUT_US;
+	}
+#endif
+	client_moveresize(c);
+}
+
 // Handle user resizing a window with the mouse.  Takes over processing X
 // motion events until the mouse button is released.
 //
-// Note that because of the way this draws an outline, other events are blocked
-// until the mouse is moved.  TODO: consider using a SHAPEd window for this,
-// where available.
+// If solid resize is enabled, the client is resized as the pointer moves, paced
+// as described for struct resize_pace.  Otherwise an outline is shown.  The
+// sweep is abandoned if the client goes away.
 
 void client_resize_sweep(struct client *c, unsigned button) {
 	// Ensure we can grab pointer events.
@@ -157,58 +445,129 @@ void client_resize_sweep(struct client *c, unsigned button) {
 	int old_cx = c->x;
 	int old_cy = c->y;
 
+	struct resize_pace pace = {
+		.frame_us = option.dragrate > 0 ? 1000000 / option.dragrate : 0,
+		.next_us = 0,
+	};
+	_Bool solid = OPTION_SOLID_RESIZE;
+	_Bool pending = 0;
+	_Bool sweeping = 1;
+
 #ifdef INFOBANNER_MOVERESIZE
 	create_info_window(c);
 #endif
-	XGrabServer(display.dpy);
-	draw_outline(c);  // draw
+	if (!solid) {
+		show_outline(c);
+	} else {
+#ifdef XSYNC
+		resize_sync_init(c, &pace);
+#endif
+		c->interactive = 1;
+	}
 
 	// Warp pointer to the bottom-right of the client for resizing
 	setmouse(c->window, c->width, c->height);
 
-	for (;;) {
+	while (sweeping && !c->remove) {
 		XEvent ev;
-		XMaskEvent(display.dpy, ButtonPressMask|ButtonReleaseMask|PointerMotionMask, &ev);
+		if (!XCheckMaskEvent(display.dpy, ButtonPressMask|ButtonReleaseMask|PointerMotionMask, &ev)) {
+			if (pending) {
+				// Wait for more input until the client is
+				// ready for a new size, then apply the latest.
+				long long delay = resize_delay(&pace);
+				if (delay > 0) {
+					loop_wait(delay);
+					continue;
+				}
+				resize_apply(c, &pace);
+				pending = 0;
+				continue;
+			}
+			// Any held ConfigureNotify is sent by its timer
+			// while waiting here.
+			loop_wait(-1);
+			continue;
+		}
 		switch (ev.type) {
 			case MotionNotify:
+				compress_motion(&ev);
 				if (ev.xmotion.root != c->screen->root)
 					break;
-				draw_outline(c);  // erase
-				XUngrabServer(display.dpy);
 				recalculate_sweep(c, old_cx, old_cy, ev.xmotion.x, ev.xmotion.y, ev.xmotion.state & altmask);
 #ifdef INFOBANNER_MOVERESIZE
 				update_info_window(c);
 #endif
-				XSync(display.dpy, False);
-				XGrabServer(display.dpy);
-				draw_outline(c);  // draw
+				if (!solid) {
+					update_outline(c);
+				} else if (resize_delay(&pace) <= 0) {
+					resize_apply(c, &pace);
+					pending = 0;
+				} else {
+					if (pending)
+						stats_count(motion_coalesced, 1);
+					pending = 1;
+				}
 				break;
 
 			case ButtonRelease:
-				if (ev.xbutton.button != button)
-					continue;
-				draw_outline(c);  // erase
-				XUngrabServer(display.dpy);
-#ifdef INFOBANNER_MOVERESIZE
-				remove_info_window();
-#endif
-				XUngrabPointer(display.dpy, CurrentTime);
-				client_moveresizeraise(c);
-				// In case maximise state has changed:
-				ewmh_set_net_wm_state(c);
-				return;
+				if (ev.xbutton.button == button)
+					sweeping = 0;
+				break;
 
 			default:
 				break;
 		}
 	}
+
+	if (!solid) {
+		hide_outline(c);
+	}
+#ifdef XSYNC
+	if (pace.alarm != None)
+		XSyncDestroyAlarm(display.dpy, pace.alarm);
+#endif
+	c->interactive = 0;
+#ifdef INFOBANNER_MOVERESIZE
+	remove_info_window();
+#endif
+	XUngrabPointer(display.dpy, CurrentTime);
+	if (c->remove)
+		return;
+	client_moveresizeraise(c);
+	// In case maximise state has changed:
+	ewmh_set_net_wm_state(c);
+}
+
+// Move a client being dragged to a new pointer position.
+
+static void drag_to(struct client *c, struct monitor *monitor, const struct snap_index *si,
+		    int x, int y, _Bool snap) {
+	c->x = x;
+	c->y = y;
+	if (option.snap && snap)
+		snap_client(c, monitor, si);
+
+#ifdef INFOBANNER_MOVERESIZE
+	update_info_window(c);
+#endif
+	if (OPTION_NO_SOLID_DRAG) {
+		update_outline(c);
+	} else {
+		XMoveWindow(display.dpy, c->parent,
+				c->x - c->border,
+				c->y - c->border);
+		send_config(c);
+	}
 }
 
 // Handle user moving a window with the mouse.  Takes over processing X motion
 // events until the mouse button is released.
 //
-// If solid drag is disabled, an outline is drawn, which leads to the same
-// limitations as in the sweep() function.
+// Only the latest of any queued motion events is acted on.  If a drag rate is
+// configured, moves are further limited to that many per second, with the
+// latest position held until the next is due.
+//
+// If solid drag is disabled, an outline is shown instead.
 
 void client_move_drag(struct client *c, unsigned button) {
 	// Ensure we can grab pointer events.
@@ -226,57 +585,81 @@ void client_move_drag(struct client *c, unsigned button) {
 	get_pointer_root_xy(c->screen->root, &x1, &y1);
 
 	struct monitor *monitor = client_monitor(c, NULL);
+	struct snap_index snaps;
+	snap_index_init(&snaps, c);
+
+	// Frame pacing state
+	long long frame_us = option.dragrate > 0 ? 1000000 / option.dragrate : 0;
+	long long next_frame_us = 0;
+	_Bool pending = 0;
+	int pending_x = 0, pending_y = 0;
+	_Bool pending_snap = 0;
+
+	// Client is told of its new position according to the configdelay
+	// option.
+	c->interactive = 1;
 
 #ifdef INFOBANNER_MOVERESIZE
 	create_info_window(c);
 #endif
 	if (OPTION_NO_SOLID_DRAG) {
-		XGrabServer(display.dpy);
-		draw_outline(c);  // draw
+		show_outline(c);
 	}
 
 	for (;;) {
 		XEvent ev;
-		XMaskEvent(display.dpy, ButtonPressMask|ButtonReleaseMask|PointerMotionMask, &ev);
+		if (!XCheckMaskEvent(display.dpy, ButtonPressMask|ButtonReleaseMask|PointerMotionMask, &ev)) {
+			if (pending) {
+				// Wait for more input until the next move is
+				// due, then apply the held position.
+				long long delay = next_frame_us - get_time_us();
+				if (delay > 0 && loop_wait(delay))
+					continue;
+				drag_to(c, monitor, &snaps, pending_x, pending_y, pending_snap);
+				pending = 0;
+				next_frame_us = get_time_us() + frame_us;
+				continue;
+			}
+			// If the pointer pauses, any held ConfigureNotify is
+			// sent by its timer while waiting here, so the client
+			// catches up with where it is.
+			loop_wait(-1);
+			continue;
+		}
 		switch (ev.type) {
 			case MotionNotify:
+				compress_motion(&ev);
 				if (ev.xmotion.root != c->screen->root)
 					break;
-				if (OPTION_NO_SOLID_DRAG) {
-					draw_outline(c);  // erase
-					XUngrabServer(display.dpy);
-				}
-				c->x = old_cx + (ev.xmotion.x - x1);
-				c->y = old_cy + (ev.xmotion.y - y1);
-				if (option.snap && !(ev.xmotion.state & altmask))
-					snap_client(c, monitor);
-
-#ifdef INFOBANNER_MOVERESIZE
-				update_info_window(c);
-#endif
-				if (OPTION_NO_SOLID_DRAG) {
-					XSync(display.dpy, False);
-					XGrabServer(display.dpy);
-					draw_outline(c);  // draw
-				} else {
-					XMoveWindow(display.dpy, c->parent,
-							c->x - c->border,
-							c->y - c->border);
-					send_config(c);
+				pending_x = old_cx + (ev.xmotion.x - x1);
+				pending_y = old_cy + (ev.xmotion.y - y1);
+				pending_snap = !(ev.xmotion.state & altmask);
+				if (frame_us && get_time_us() < next_frame_us) {
+					if (pending)
+						stats_count(motion_coalesced, 1);
+					pending = 1;
+					break;
 				}
+				drag_to(c, monitor, &snaps, pending_x, pending_y, pending_snap);
+				pending = 0;
+				next_frame_us = get_time_us() + frame_us;
 				break;
 
 			case ButtonRelease:
 				if (ev.xbutton.button != button)
 					continue;
+				if (pending)
+					drag_to(c, monitor, &snaps, pending_x, pending_y, pending_snap);
+				c->interactive = 0;
+				client_flush_config(c);
 				if (OPTION_NO_SOLID_DRAG) {
-					draw_outline(c);  // erase
-					XUngrabServer(display.dpy);
+					hide_outline(c);
 				}
 #ifdef INFOBANNER_MOVERESIZE
 				remove_info_window();
 #endif
 				XUngrabPointer(display.dpy, CurrentTime);
+				snap_index_free(&snaps);
 				if (OPTION_NO_SOLID_DRAG) {
 					// For solid drags, the client was
 					// moved with the mouse.  For non-solid
@@ -320,7 +703,7 @@ void client_show_info(struct client *c, XEvent *e) {
 
 	if (e->type == KeyPress) {
 		input = e->xkey.keycode;
-		if (XGrabKeyboard(display.dpy, c->screen->root, False, GrabModeAsync, GrabModeAsync, CurrentTime) != GrabSuccess)
+		if (!grab_keyboard(c->screen->root))
 			return;
 	} else {
 		input = e->xbutton.button;
@@ -331,8 +714,7 @@ void client_show_info(struct client *c, XEvent *e) {
 #ifdef INFOBANNER
 	create_info_window(c);
 #else
-	XGrabServer(display.dpy);
-	draw_outline(c);
+	show_outline(c);
 #endif
 
 	for (;;) {
@@ -356,8 +738,7 @@ void client_show_info(struct client *c, XEvent *e) {
 #ifdef INFOBANNER
 	remove_info_window();
 #else
-	draw_outline(c);
-	XUngrabServer(display.dpy);
+	hide_outline(c);
 #endif
 
 	if (e->type == KeyPress) {
@@ -479,20 +860,18 @@ void client_maximise(struct client *c, int action, int hv) {
 // clients_tab_order list).
 
 void client_select_next(void) {
-	struct list *newl = list_find(clients_tab_order, current);
-	struct client *newc;
+	struct client *newc = current;
 
 	do {
-		if (newl) {
-			newl = newl->next;
-			if (!newl && !current)
+		if (newc) {
+			newc = client_list_next(&clients_tab_order, newc);
+			if (!newc && !current)
 				return;
 		}
-		if (!newl)
-			newl = clients_tab_order;
-		if (!newl)
+		if (!newc)
+			newc = clients_tab_order.head;
+		if (!newc)
 			return;
-		newc = newl->data;
 		if (newc == current)
 			return;
 	} while ((!is_fixed(newc) && (newc->vdesk != newc->screen->vdesk))
@@ -16,6 +16,12 @@
 #include <X11/X.h>
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
+#include <X11/Xatom.h>
+
+#ifdef XCB
+#include <X11/Xlib-xcb.h>
+#include <xcb/xcb.h>
+#endif
 
 #ifdef SHAPE
 #include <X11/extensions/shape.h>
@@ -29,111 +35,209 @@
 #include "list.h"
 #include "log.h"
 #include "screen.h"
+#include "stats.h"
 #include "util.h"
 
-static void init_geometry(struct client *c, _Bool ignore_position, _Bool ignore_border);
+// Everything we need to know about a window before managing it.  Gathering
+// it all up front means that with XCB, every request can be sent before
+// waiting for any reply, costing one round trip instead of about ten.
+
+enum {
+	NEW_WINDOW_PROP_WINDOW_TYPE,
+	NEW_WINDOW_PROP_CLASS,
+	NEW_WINDOW_PROP_MWM_HINTS,
+	NEW_WINDOW_PROP_DESKTOP,
+	NEW_WINDOW_PROP_UNMAXIMISED_HORZ,
+	NEW_WINDOW_PROP_UNMAXIMISED_VERT,
+	NEW_WINDOW_PROP_NORMAL_HINTS,
+	NUM_NEW_WINDOW_PROPS
+};
+
+struct new_window {
+	Window w;
+	struct screen *s;
+	_Bool existing;  // adopting at startup: only manage if viewable
+	_Bool first;  // first in a batch of requests
+
+#ifdef XCB
+	xcb_get_window_attributes_cookie_t attr_cookie;
+	xcb_get_geometry_cookie_t geom_cookie;
+	xcb_get_property_cookie_t prop_cookie[NUM_NEW_WINDOW_PROPS];
+	xcb_query_pointer_cookie_t pointer_cookie;
+#endif
+
+	XWindowAttributes attr;
+	unsigned window_type;
+	struct application *app;
+	int mwm_border;
+	_Bool mwm_cached;  // mwm_border already known, hints not fetched
+	unsigned vdesk;  // VDESK_NONE if not hinted
+	_Bool have_unmaximised_horz, have_unmaximised_vert;
+	long unmaximised_horz[2], unmaximised_vert[2];
+	XSizeHints size;
+	Bool pointer_same_screen;
+	int pointer_x, pointer_y;
+};
+
+// Windows fetched together when adopting existing windows.  No server grab is
+// held either way.  With XCB, a window that has gone away shows up as an error
+// in its own replies, so a batch only bounds how many requests are
+// outstanding.  Without XCB, each window's errors are attributed to it by
+// serial range (see xerror_expect_begin()).  Every call waits for its reply,
+// so there is nothing to gain from batching.
+#ifdef XCB
+#define MANAGE_BATCH 64
+#else
+#define MANAGE_BATCH 1
+#endif
+
+static void new_window_request(struct new_window *nw);
+static _Bool new_window_collect(struct new_window *nw);
+static struct client *manage_window(struct new_window *nw);
+static _Bool want_focus(struct client *c, struct new_window *nw);
+static void focus_new_client(struct client *c);
+static struct application *find_application(const char *res_name, const char *res_class);
+static void init_geometry(struct client *c, struct new_window *nw);
 static void reparent(struct client *c);
 
 // client_manage_new is called when a map request event for an unmanaged window
 // is handled, and on startup for all windows found.
 
 void client_manage_new(Window w, struct screen *s) {
+	struct new_window nw = { .w = w, .s = s, .first = 1 };
 	struct client *c;
-	char *name;
-	XClassHint *class;
-	struct application *app = NULL;
-	unsigned window_type;
 
 	LOG_ENTER("client_manage_new(window=%lx)", (unsigned long)w);
 
-	XGrabServer(display.dpy);
-
-	// First a bit of interaction with the error handler due to X's
-	// tendency to batch event notifications.  We set a global variable to
-	// the id of the window we're initialising then do simple X call on
-	// that window.  If an error is raised by this (and nothing else should
-	// do so as we've grabbed the server), the error handler resets the
-	// variable indicating the window has already disappeared, so we stop
-	// trying to manage it.
-
-	initialising = w;
-	XFetchName(display.dpy, w, &name);
-	XSync(display.dpy, False);
+	if (!s) {
+		LOG_DEBUG("no screen for window - aborting...\n");
+		LOG_LEAVE();
+		return;
+	}
 
-	// If 'initialising' is now set to None, that means doing the
-	// XFetchName raised BadWindow - the window has been removed before
-	// we got a chance to grab the server. */
+	// The server is not grabbed: the window may disappear at any point.
+	// Errors while fetching its information are expected, and abort
+	// managing it.  Anything we do to the window after that happens once
+	// it is attached to the client lists, so if it has gone away, the
+	// resulting X error will just flag it for removal.
 
-	if (initialising == None) {
+	new_window_request(&nw);
+	if (!new_window_collect(&nw)) {
 		LOG_DEBUG("XError occurred for initialising window - aborting...\n");
-		XUngrabServer(display.dpy);
 		LOG_LEAVE();
 		return;
 	}
-	initialising = None;
+
+	c = manage_window(&nw);
+	if (c && want_focus(c, &nw))
+		focus_new_client(c);
+
+	LOG_LEAVE();
+}
+
+// Adopt windows that already exist when the window manager starts.  With
+// XCB, the information for a whole batch of windows is requested before any
+// replies are waited for.  Focus is only set once, for the last window that
+// would have received it had they been managed one at a time.  Returns the
+// number of clients managed.
+
+unsigned client_manage_existing(struct screen *s, Window *wins, unsigned nwins) {
+	struct new_window nw[MANAGE_BATCH];
+	_Bool ok[MANAGE_BATCH];
+	struct client *focus = NULL;
+	unsigned nmanaged = 0;
+
+	LOG_ENTER("client_manage_existing(screen=%d, %u windows)", s->screen, nwins);
+
+	for (unsigned i = 0; i < nwins; i += MANAGE_BATCH) {
+		unsigned n = nwins - i;
+		if (n > MANAGE_BATCH)
+			n = MANAGE_BATCH;
+
+		for (unsigned j = 0; j < n; j++) {
+			nw[j] = (struct new_window){ .w = wins[i+j], .s = s, .existing = 1, .first = (j == 0) };
+			new_window_request(&nw[j]);
+		}
+		for (unsigned j = 0; j < n; j++) {
+			ok[j] = new_window_collect(&nw[j]);
+		}
+
+		for (unsigned j = 0; j < n; j++) {
+			if (!ok[j])
+				continue;
+			struct client *c = manage_window(&nw[j]);
+			if (!c)
+				continue;
+			nmanaged++;
+			if (want_focus(c, &nw[j]))
+				focus = c;
+		}
+	}
+
+	if (focus)
+		focus_new_client(focus);
+	XFlush(display.dpy);
+
+	LOG_LEAVE();
+	return nmanaged;
+}
+
+// Manage a window once its information has been fetched.  Returns the new
+// client, or NULL if the window was not managed.
+
+static struct client *manage_window(struct new_window *nw) {
+	Window w = nw->w;
+	struct screen *s = nw->s;
+	struct client *c;
+	struct application *app;
+
 	LOG_DEBUG("screen=%d\n", s->screen);
-	LOG_DEBUG("name=%s\n", name ? name : "Untitled");
-	if (name)
-		XFree(name);
 
-	window_type = ewmh_get_net_wm_window_type(w);
 	// Don't manage DESKTOP type windows
-	if (window_type & EWMH_WINDOW_TYPE_DESKTOP) {
+	if (nw->window_type & EWMH_WINDOW_TYPE_DESKTOP) {
 		XMapWindow(display.dpy, w);
-		XUngrabServer(display.dpy);
-		return;
+		return NULL;
 	}
 
 	// If allocation fails, don't crash the window manager.  Just don't
-	// manage the window.
+	// manage the window.  This includes ensuring there's room to add it
+	// to the EWMH client lists.
 	c = malloc(sizeof(struct client));
-	if (!c) {
+	if (!c || !ewmh_client_list_reserve(s) || !client_index_add(w, c)) {
 		LOG_ERROR("out of memory allocating new client\n");
+		free(c);
 		XMapWindow(display.dpy, w);
-		XUngrabServer(display.dpy);
-		LOG_LEAVE();
-		return;
+		return NULL;
 	}
-	clients_tab_order = list_prepend(clients_tab_order, c);
-	clients_mapping_order = list_append(clients_mapping_order, c);
-	clients_stacking_order = list_append(clients_stacking_order, c);
+	client_list_prepend(&clients_tab_order, c);
+	client_list_append(&clients_mapping_order, c);
+	client_list_append(&clients_stacking_order, c);
 
 	c->screen = s;
 	c->window = w;
+	c->parent = None;
 	c->ignore_unmap = 0;
 	c->remove = 0;
-
-	// Ungrab the X server as soon as possible. Now that the client is
-	// malloc()ed and attached to the list, it is safe for any subsequent
-	// X calls to raise an X error and thus flag it for removal.
-
-	XUngrabServer(display.dpy);
-
-	// Find application-specific configuration for name/class:
-	class = XAllocClassHint();
-	if (class) {
-		XGetClassHint(display.dpy, w, class);
-		for (struct list *iter = applications; iter; iter = iter->next) {
-			struct application *a = iter->data;
-			// Does resource name and class match?
-			if ((!a->res_name || (class->res_name && !strcmp(class->res_name, a->res_name)))
-			    && (!a->res_class || (class->res_class && !strcmp(class->res_class, a->res_class)))) {
-				app = a;
-				break;
-			}
-		}
-		XFree(class->res_name);
-		XFree(class->res_class);
-		XFree(class);
-	}
-
-	update_window_type_flags(c, window_type);
-	init_geometry(c, app ? app->ignore_position : 0, app ? app->ignore_border : 0);
+	c->interactive = 0;
+	c->config_pending = 0;
+	c->config_sent_us = 0;
+	c->config_timer = 0;
+	c->monitor_generation = 0;
+	for (int i = 0; i < NUM_CLIENT_LAYOUTS; i++)
+		c->layouts[i].layout = 0;
+
+	app = nw->app;
+	update_window_type_flags(c, nw->window_type);
+	init_geometry(c, nw);
+
+	// Initial vdesk is now known, so add client to the list for that
+	// vdesk.  It is moved if application configuration overrides it.
+	client_vdesk_link(c);
 
 #ifdef DEBUG
 	{
 		int i = 0;
-		for (struct list *iter = clients_tab_order; iter; iter = iter->next)
+		for (struct client *ci = clients_tab_order.head; ci; ci = client_list_next(&clients_tab_order, ci))
 			i++;
 		LOG_DEBUG("new window %dx%d+%d+%d, wincount=%d\n", c->width, c->height, c->x, c->y, i);
 	}
@@ -180,9 +284,10 @@ void client_manage_new(Window w, struct screen *s) {
 		if (app->is_dock)
 			c->is_dock = 1;
 
+		unsigned vdesk = c->vdesk;
 		if (app->vdesk && *(app->vdesk) == 'F') {
 			// Fix app
-			c->vdesk = VDESK_FIXED;
+			vdesk = VDESK_FIXED;
 		} else if (app->vdesk) {
 			// Force app to specific vdesk
 			char *next = NULL;
@@ -199,23 +304,27 @@ void client_manage_new(Window w, struct screen *s) {
 					row = 0;
 				if (row > VDESK_MAX_ROW)
 					row = VDESK_MAX_ROW;
-				c->vdesk = row * option.vdeskcolumns + col;
+				vdesk = row * option.vdeskcolumns + col;
 			} else {
 				// Absolute vdesk number
 				if (col >= option.vdeskcolumns * option.vdeskrows) {
 					col = (option.vdeskcolumns * option.vdeskrows) - 1;
 				}
-				c->vdesk = col;
+				vdesk = col;
 			}
 		}
+		if (vdesk != c->vdesk) {
+			client_list_remove(screen_vdesk_clients(s, c->vdesk), c);
+			c->vdesk = vdesk;
+			client_vdesk_link(c);
+		}
 	}
 
 	// Set EWMH property on client advertising WM features
 	ewmh_set_allowed_actions(c);
 
-	// Update EWMH client list hints for screen
-	ewmh_set_net_client_list(c->screen);
-	ewmh_set_net_client_list_stacking(c->screen);
+	// Add to EWMH client list hints for screen
+	ewmh_client_list_add(c);
 
 	// Only map the window frame (and thus the window) if it's supposed
 	// to be visible on this virtual desktop.  Otherwise, set it to
@@ -223,17 +332,6 @@ void client_manage_new(Window w, struct screen *s) {
 	if (is_fixed(c) || c->vdesk == s->vdesk) {
 		client_show(c);
 		client_raise(c);
-		// Don't focus windows that aren't on the same display as the
-		// pointer.
-		if (get_pointer_root_xy(c->window, NULL, NULL) &&
-		    !(window_type & (EWMH_WINDOW_TYPE_DOCK|EWMH_WINDOW_TYPE_NOTIFICATION))) {
-			select_client(c);
-#ifdef WARP_POINTER
-			setmouse(c->window, c->width + c->border - 1,
-				 c->height + c->border - 1);
-#endif
-			discard_enter_events(c);
-		}
 	} else {
 		set_wm_state(c, IconicState);
 	}
@@ -241,39 +339,372 @@ void client_manage_new(Window w, struct screen *s) {
 	// Ensure whichever vdesk it ended up on is reflected in the EWMH hints
 	ewmh_set_net_wm_desktop(c);
 
-	LOG_LEAVE();
+	return c;
+}
+
+// Newly managed clients are focussed if visible, unless they aren't on the
+// same display as the pointer.
+
+static _Bool want_focus(struct client *c, struct new_window *nw) {
+	return (is_fixed(c) || c->vdesk == c->screen->vdesk) &&
+		nw->pointer_same_screen &&
+		!(nw->window_type & (EWMH_WINDOW_TYPE_DOCK|EWMH_WINDOW_TYPE_NOTIFICATION));
+}
+
+static void focus_new_client(struct client *c) {
+	select_client(c);
+#ifdef WARP_POINTER
+	setmouse(c->window, c->width + c->border - 1,
+		 c->height + c->border - 1);
+#endif
+	discard_enter_events(c);
 }
 
-// Fetches various hints to determine a window's initial geometry.
+#ifdef XCB
+
+// Send all the requests needed to manage a window without waiting for any
+// replies.  Xlib and XCB share the connection, so these are correctly
+// sequenced after anything Xlib has buffered.
+
+static void new_window_request(struct new_window *nw) {
+	// Property and expected type for each request
+	Atom props[NUM_NEW_WINDOW_PROPS][2] = {
+		[NEW_WINDOW_PROP_WINDOW_TYPE] = { X_ATOM(_NET_WM_WINDOW_TYPE), XA_ATOM },
+		[NEW_WINDOW_PROP_CLASS] = { XA_WM_CLASS, XA_STRING },
+		[NEW_WINDOW_PROP_MWM_HINTS] = { X_ATOM(_MOTIF_WM_HINTS), X_ATOM(_MOTIF_WM_HINTS) },
+		[NEW_WINDOW_PROP_DESKTOP] = { X_ATOM(_NET_WM_DESKTOP), XA_CARDINAL },
+		[NEW_WINDOW_PROP_UNMAXIMISED_HORZ] = { X_ATOM(_EVILWM_UNMAXIMISED_HORZ), XA_CARDINAL },
+		[NEW_WINDOW_PROP_UNMAXIMISED_VERT] = { X_ATOM(_EVILWM_UNMAXIMISED_VERT), XA_CARDINAL },
+		[NEW_WINDOW_PROP_NORMAL_HINTS] = { XA_WM_NORMAL_HINTS, XA_WM_SIZE_HINTS },
+	};
+	xcb_connection_t *xc = XGetXCBConnection(display.dpy);
+
+	// The border may already be known if the window asked for its frame
+	// extents.
+	nw->mwm_cached = cached_window_normal_border(nw->w, &nw->mwm_border);
+
+	// XCB returns request cookies by value.
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Waggregate-return"
+#endif
+	nw->attr_cookie = xcb_get_window_attributes(xc, nw->w);
+	nw->geom_cookie = xcb_get_geometry(xc, nw->w);
+	for (int i = 0; i < NUM_NEW_WINDOW_PROPS; i++) {
+		if (i == NEW_WINDOW_PROP_MWM_HINTS && nw->mwm_cached)
+			continue;
+		nw->prop_cookie[i] = xcb_get_property(xc, 0, nw->w, props[i][0], props[i][1],
+						      0, MAXIMUM_PROPERTY_LENGTH / 4);
+	}
+	nw->pointer_cookie = xcb_query_pointer(xc, nw->s->root);
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif
+}
 
-static void init_geometry(struct client *c, _Bool ignore_position, _Bool ignore_border) {
+// Returns the value of a fetched property if it is of the expected type and
+// format, along with its number of items.
+
+static void *prop_value(xcb_get_property_reply_t *r, Atom type, int format,
+			unsigned long *nitems) {
+	if (!r || r->type != type || r->format != format)
+		return NULL;
+	*nitems = xcb_get_property_value_length(r) / (format / 8);
+	return xcb_get_property_value(r);
+}
+
+// Collect the replies to the requests sent by new_window_request().  Returns
+// false if the window no longer exists or should not be managed.
+
+static _Bool new_window_collect(struct new_window *nw) {
+	xcb_connection_t *xc = XGetXCBConnection(display.dpy);
+	xcb_get_window_attributes_reply_t *attr;
+	xcb_get_geometry_reply_t *geom;
+	xcb_get_property_reply_t *prop[NUM_NEW_WINDOW_PROPS];
+	xcb_query_pointer_reply_t *pointer;
 	unsigned long nitems;
-	XWindowAttributes attr;
+	uint32_t *v;
+	_Bool exists;
+
+	// Replies for a batch arrive together, so only waiting for the first
+	// of them really costs a round trip.
+	if (nw->first)
+		stats_round_trip();
+
+	// Errors are returned here rather than reaching the Xlib error
+	// handler.  A failure to get attributes means the window has been
+	// removed.
+	attr = xcb_get_window_attributes_reply(xc, nw->attr_cookie, NULL);
+	geom = xcb_get_geometry_reply(xc, nw->geom_cookie, NULL);
+	for (int i = 0; i < NUM_NEW_WINDOW_PROPS; i++) {
+		prop[i] = NULL;
+		if (i != NEW_WINDOW_PROP_MWM_HINTS || !nw->mwm_cached)
+			prop[i] = xcb_get_property_reply(xc, nw->prop_cookie[i], NULL);
+	}
+	pointer = xcb_query_pointer_reply(xc, nw->pointer_cookie, NULL);
+
+	exists = attr && geom;
+	// Override redirect implies a pop-up that we should ignore.  If an
+	// existing window is not viewable, it shouldn't be shown right now,
+	// so don't try to manage it.
+	if (exists && nw->existing && (attr->override_redirect
+				       || attr->map_state != XCB_MAP_STATE_VIEWABLE))
+		exists = 0;
+	if (!exists)
+		goto done;
+
+	memset(&nw->attr, 0, sizeof(nw->attr));
+	nw->attr.x = geom->x;
+	nw->attr.y = geom->y;
+	nw->attr.width = geom->width;
+	nw->attr.height = geom->height;
+	nw->attr.border_width = geom->border_width;
+	nw->attr.depth = geom->depth;
+	nw->attr.root = geom->root;
+	nw->attr.class = attr->_class;
+	nw->attr.map_state = attr->map_state;
+	nw->attr.colormap = attr->colormap;
+	nw->attr.override_redirect = attr->override_redirect;
+	nw->attr.your_event_mask = attr->your_event_mask;
+	nw->attr.all_event_masks = attr->all_event_masks;
+
+	nw->window_type = 0;
+	if ((v = prop_value(prop[NEW_WINDOW_PROP_WINDOW_TYPE], XA_ATOM, 32, &nitems))) {
+		for (unsigned long i = 0; i < nitems; i++)
+			nw->window_type |= ewmh_window_type_flag(v[i]);
+	}
 
-	// Normal border size from MWM hints
-	c->normal_border = ignore_border ? option.bw : window_normal_border(c->window);
+	// WM_CLASS is two consecutive NUL-terminated strings
+	nw->app = NULL;
+	if (applications) {
+		char *class = prop_value(prop[NEW_WINDOW_PROP_CLASS], XA_STRING, 8, &nitems);
+		char *res_name = NULL, *res_class = NULL;
+		if (class && (res_name = malloc(nitems + 1))) {
+			memcpy(res_name, class, nitems);
+			res_name[nitems] = 0;
+			size_t len = strlen(res_name);
+			if (len < nitems)
+				res_class = res_name + len + 1;
+		}
+		nw->app = find_application(res_name, res_class);
+		free(res_name);
+	}
 
-	// Possible get a value for initial virtual desktop from EWMH hint
-	unsigned long *lprop;
-	c->vdesk = c->screen->vdesk;
-	if ( (lprop = get_property(c->window, X_ATOM(_NET_WM_DESKTOP), XA_CARDINAL, &nitems)) ) {
+	if (!nw->mwm_cached)
+		nw->mwm_border = option.bw;
+	if ((v = prop_value(prop[NEW_WINDOW_PROP_MWM_HINTS], X_ATOM(_MOTIF_WM_HINTS), 32, &nitems))) {
+		PropMwmHints mwm = { 0, 0, 0 };
+		if (nitems >= PROP_MWM_HINTS_ELEMENTS) {
+			mwm.flags = v[0];
+			mwm.functions = v[1];
+			mwm.decorations = v[2];
+		}
+		nw->mwm_border = mwm_hints_normal_border(&mwm, nitems);
+	}
+
+	nw->vdesk = VDESK_NONE;
+	if ((v = prop_value(prop[NEW_WINDOW_PROP_DESKTOP], XA_CARDINAL, 32, &nitems))) {
+		if (nitems)
+			nw->vdesk = v[0];
+	}
+
+	nw->have_unmaximised_horz = 0;
+	if ((v = prop_value(prop[NEW_WINDOW_PROP_UNMAXIMISED_HORZ], XA_CARDINAL, 32, &nitems))) {
+		if (nitems == 2) {
+			nw->unmaximised_horz[0] = (int32_t)v[0];
+			nw->unmaximised_horz[1] = (int32_t)v[1];
+			nw->have_unmaximised_horz = 1;
+		}
+	}
+
+	nw->have_unmaximised_vert = 0;
+	if ((v = prop_value(prop[NEW_WINDOW_PROP_UNMAXIMISED_VERT], XA_CARDINAL, 32, &nitems))) {
+		if (nitems == 2) {
+			nw->unmaximised_vert[0] = (int32_t)v[0];
+			nw->unmaximised_vert[1] = (int32_t)v[1];
+			nw->have_unmaximised_vert = 1;
+		}
+	}
+
+	// Decode WM_NORMAL_HINTS as XGetWMNormalHints() would.  Pre-ICCCM
+	// clients supply only 15 elements, without base size or gravity.
+	memset(&nw->size, 0, sizeof(nw->size));
+	if ((v = prop_value(prop[NEW_WINDOW_PROP_NORMAL_HINTS], XA_WM_SIZE_HINTS, 32, &nitems))
+	    && nitems >= 15) {
+		int32_t *iv = (int32_t *)v;
+		nw->size.flags = v[0] & (USPosition|USSize|PAllHints|PBaseSize|PWinGravity);
+		nw->size.x = iv[1];
+		nw->size.y = iv[2];
+		nw->size.width = iv[3];
+		nw->size.height = iv[4];
+		nw->size.min_width = iv[5];
+		nw->size.min_height = iv[6];
+		nw->size.max_width = iv[7];
+		nw->size.max_height = iv[8];
+		nw->size.width_inc = iv[9];
+		nw->size.height_inc = iv[10];
+		nw->size.min_aspect.x = iv[11];
+		nw->size.min_aspect.y = iv[12];
+		nw->size.max_aspect.x = iv[13];
+		nw->size.max_aspect.y = iv[14];
+		if (nitems >= 18) {
+			nw->size.base_width = iv[15];
+			nw->size.base_height = iv[16];
+			nw->size.win_gravity = iv[17];
+		} else {
+			nw->size.flags &= ~(PBaseSize|PWinGravity);
+		}
+	}
+
+	nw->pointer_same_screen = False;
+	nw->pointer_x = nw->pointer_y = 0;
+	if (pointer) {
+		nw->pointer_same_screen = pointer->same_screen;
+		nw->pointer_x = pointer->root_x;
+		nw->pointer_y = pointer->root_y;
+	}
+
+done:
+	free(attr);
+	free(geom);
+	for (int i = 0; i < NUM_NEW_WINDOW_PROPS; i++)
+		free(prop[i]);
+	free(pointer);
+	return exists;
+}
+
+#else
+
+// Without XCB, nothing can be sent ahead of time.
+
+static void new_window_request(struct new_window *nw) {
+	(void)nw;
+}
+
+// Fetch window information with the usual blocking Xlib calls.  Returns
+// false if the window no longer exists or should not be managed.
+
+static _Bool new_window_collect(struct new_window *nw) {
+	Window w = nw->w;
+	unsigned long nitems;
+	long *lprop;
+	XClassHint *class;
+
+	// The window may already have been destroyed, or may be destroyed
+	// while we're fetching its information.  Tell the error handler to
+	// expect that, and count the errors: every call here waits for a
+	// reply, so any error will have been seen by the end.
+
+	xerror_expect_begin(w);
+	LOG_XENTER("XGetWindowAttributes(window=%lx)", (unsigned long)w);
+	Status ok = get_window_attributes(w, &nw->attr);
+	LOG_XLEAVE();
+	if (!ok) {
+		xerror_expect_end();
+		return 0;
+	}
+
+	// Override redirect implies a pop-up that we should ignore.  If an
+	// existing window is not viewable, it shouldn't be shown right now,
+	// so don't try to manage it.
+	if (nw->existing && (nw->attr.override_redirect
+			     || nw->attr.map_state != IsViewable)) {
+		xerror_expect_end();
+		return 0;
+	}
+
+	nw->window_type = ewmh_get_net_wm_window_type(w);
+
+	// Find application-specific configuration for name/class:
+	nw->app = NULL;
+	if (applications && (class = XAllocClassHint())) {
+		get_class_hint(w, class);
+		nw->app = find_application(class->res_name, class->res_class);
+		XFree(class->res_name);
+		XFree(class->res_class);
+		XFree(class);
+	}
+
+	nw->mwm_border = window_normal_border(w);
+
+	nw->vdesk = VDESK_NONE;
+	if ( (lprop = get_property(w, X_ATOM(_NET_WM_DESKTOP), XA_CARDINAL, &nitems)) ) {
 		// NB, Xlib not only returns a 32bit value in a long (which may
 		// not be 32bits), it also sign extends the 32bit value
-		if (nitems && valid_vdesk(lprop[0] & UINT32_MAX)) {
-			c->vdesk = lprop[0] & UINT32_MAX;
+		if (nitems)
+			nw->vdesk = lprop[0] & UINT32_MAX;
+		XFree(lprop);
+	}
+
+	nw->have_unmaximised_horz = 0;
+	if ( (lprop = get_property(w, X_ATOM(_EVILWM_UNMAXIMISED_HORZ), XA_CARDINAL, &nitems)) ) {
+		if (nitems == 2) {
+			nw->unmaximised_horz[0] = lprop[0];
+			nw->unmaximised_horz[1] = lprop[1];
+			nw->have_unmaximised_horz = 1;
 		}
 		XFree(lprop);
 	}
 
-	// Get current window attributes
-	LOG_XENTER("XGetWindowAttributes(window=%lx)", (unsigned long)c->window);
-	XGetWindowAttributes(display.dpy, c->window, &attr);
-	debug_window_attributes(&attr);
+	nw->have_unmaximised_vert = 0;
+	if ( (lprop = get_property(w, X_ATOM(_EVILWM_UNMAXIMISED_VERT), XA_CARDINAL, &nitems)) ) {
+		if (nitems == 2) {
+			nw->unmaximised_vert[0] = lprop[0];
+			nw->unmaximised_vert[1] = lprop[1];
+			nw->have_unmaximised_vert = 1;
+		}
+		XFree(lprop);
+	}
+
+	memset(&nw->size, 0, sizeof(nw->size));
+	LOG_XENTER("XGetWMNormalHints(window=%lx)", (unsigned long)w);
+	get_size_hints(w, &nw->size);
 	LOG_XLEAVE();
+
+	nw->pointer_same_screen = get_pointer_root_xy(nw->s->root, &nw->pointer_x, &nw->pointer_y);
+
+	return xerror_expect_end() == 0;
+}
+
+#endif
+
+// Find application-specific configuration for name/class.
+
+static struct application *find_application(const char *res_name, const char *res_class) {
+	for (struct list *iter = applications; iter; iter = iter->next) {
+		struct application *a = iter->data;
+		// Does resource name and class match?
+		if ((!a->res_name || (res_name && !strcmp(res_name, a->res_name)))
+		    && (!a->res_class || (res_class && !strcmp(res_class, a->res_class)))) {
+			return a;
+		}
+	}
+	return NULL;
+}
+
+// Determine a window's initial geometry from the fetched hints.
+
+static void init_geometry(struct client *c, struct new_window *nw) {
+	XWindowAttributes *attr = &nw->attr;
+	_Bool ignore_position = nw->app ? nw->app->ignore_position : 0;
+	_Bool ignore_border = nw->app ? nw->app->ignore_border : 0;
+
+	// Normal border size from MWM hints.  Any answer cached while the
+	// window was unmanaged is no longer needed.
+	c->normal_border = ignore_border ? option.bw : nw->mwm_border;
+	forget_window_normal_border(c->window);
+
+	// Possible get a value for initial virtual desktop from EWMH hint
+	c->vdesk = c->screen->vdesk;
+	if (nw->vdesk != VDESK_NONE && valid_vdesk(nw->vdesk)) {
+		c->vdesk = nw->vdesk;
+	}
+
+	debug_window_attributes(attr);
 	// We remove any client border, so preserve its old value to restore on
 	// emulator quit.
-	c->old_border = attr.border_width;
-	c->cmap = attr.colormap;
+	c->old_border = attr->border_width;
+	c->cmap = attr->colormap;
 
 	// Default to no unmaximised width/height.
 	c->oldw = c->oldh = 0;
@@ -282,23 +713,16 @@ static void init_geometry(struct client *c, _Bool ignore_position, _Bool ignore_
 	// managed by evilwm and this property contains the unmaximised X
 	// coordinate and width.  These are unrepresented in EWMH hints, so
 	// would otherwise not survive window manager restart.
-	unsigned long *eprop;
-	if ( (eprop = get_property(c->window, X_ATOM(_EVILWM_UNMAXIMISED_HORZ), XA_CARDINAL, &nitems)) ) {
-		if (nitems == 2) {
-			c->oldx = eprop[0];
-			c->oldw = eprop[1];
-		}
-		XFree(eprop);
+	if (nw->have_unmaximised_horz) {
+		c->oldx = nw->unmaximised_horz[0];
+		c->oldw = nw->unmaximised_horz[1];
 	}
 
 	// Similarly _EVILWM_UNMAXIMISED_VERT will contain the unmaximised Y
 	// coordinate and height.
-	if ( (eprop = get_property(c->window, X_ATOM(_EVILWM_UNMAXIMISED_VERT), XA_CARDINAL, &nitems)) ) {
-		if (nitems == 2) {
-			c->oldy = eprop[0];
-			c->oldh = eprop[1];
-		}
-		XFree(eprop);
+	if (nw->have_unmaximised_vert) {
+		c->oldy = nw->unmaximised_vert[0];
+		c->oldh = nw->unmaximised_vert[1];
 	}
 
 	c->border = (c->oldw && c->oldh) ? 0 : c->normal_border;
@@ -306,15 +730,15 @@ static void init_geometry(struct client *c, _Bool ignore_position, _Bool ignore_
 	// Update some client info from the WM_NORMAL_HINTS property.  The
 	// flags returned will indicate whether certain values were user- or
 	// program-specified.
-	long size_flags = get_wm_normal_hints(c);
+	long size_flags = apply_wm_normal_hints(c, &nw->size);
 
 	_Bool need_send_config = 0;
 
 	// If the current window dimensions conform to the minimums specified
 	// in WM_NORMAL_HINTS, use them.  Otherwise, use the mimimums.
-	if ((attr.width >= c->min_width) && (attr.height >= c->min_height)) {
-		c->width = attr.width;
-		c->height = attr.height;
+	if ((attr->width >= c->min_width) && (attr->height >= c->min_height)) {
+		c->width = attr->width;
+		c->height = attr->height;
 	} else {
 		c->width = c->min_width;
 		c->height = c->min_height;
@@ -329,16 +753,14 @@ static void init_geometry(struct client *c, _Bool ignore_position, _Bool ignore_
 	// XXX: if an existing window would be mapped off the screen, would it
 	// be sensible to move it somewhere visible?
 
-	if ((attr.map_state == IsViewable) || (!ignore_position && (size_flags & USPosition))) {
-		c->x = attr.x;
-		c->y = attr.y;
+	if ((attr->map_state == IsViewable) || (!ignore_position && (size_flags & USPosition))) {
+		c->x = attr->x;
+		c->y = attr->y;
 	} else {
 		int xmax = DisplayWidth(display.dpy, c->screen->screen);
 		int ymax = DisplayHeight(display.dpy, c->screen->screen);
-		int x, y;
-		get_pointer_root_xy(c->screen->root, &x, &y);
-		c->x = (x * (xmax - c->border - c->width)) / xmax;
-		c->y = (y * (ymax - c->border - c->height)) / ymax;
+		c->x = (nw->pointer_x * (xmax - c->border - c->width)) / xmax;
+		c->y = (nw->pointer_y * (ymax - c->border - c->height)) / ymax;
 		need_send_config = 1;
 	}
 
@@ -352,7 +774,7 @@ static void init_geometry(struct client *c, _Bool ignore_position, _Bool ignore_
 	// If the window was already viewable (existed while window manager
 	// starts), that means the reparent to come would send an unmap request
 	// to the root window.  Set a flag to ignore this.
-	if (attr.map_state == IsViewable) {
+	if (attr->map_state == IsViewable) {
 		c->ignore_unmap++;
 	}
 
@@ -382,6 +804,7 @@ static void reparent(struct client *c) {
 		DefaultDepth(display.dpy, c->screen->screen), CopyFromParent,
 		DefaultVisual(display.dpy, c->screen->screen),
 		CWOverrideRedirect | CWBorderPixel | CWEventMask, &p_attr);
+	client_index_add(c->parent, c);
 
 	// Adding the original window to our "save set" means that if we die
 	// unexpectedly, the window will be reparented back to the root.
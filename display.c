@@ -25,12 +25,14 @@
 #ifdef RANDR
 #include <X11/extensions/Xrandr.h>
 #endif
+#ifdef XSYNC
+#include <X11/extensions/sync.h>
+#endif
 
 #include "client.h"
 #include "display.h"
 #include "evilwm.h"
 #include "ewmh.h"
-#include "list.h"
 #include "log.h"
 #include "screen.h"
 #include "util.h"
@@ -96,6 +98,10 @@ static const char *atom_list[] = {
 	"_NET_WM_ACTION_CLOSE",
 	"_NET_WM_PID",
 	"_NET_FRAME_EXTENTS",
+
+	// EWMH: Window Manager Protocols
+	"_NET_WM_SYNC_REQUEST",
+	"_NET_WM_SYNC_REQUEST_COUNTER",
 };
 
 // Open and initialise display.  Exits the process on failure.
@@ -168,6 +174,17 @@ void display_open(void) {
 		}
 	}
 #endif
+	// XSync extension?
+#ifdef XSYNC
+	{
+		int e_dummy, major, minor;
+		display.have_xsync = XSyncQueryExtension(display.dpy, &display.xsync_event_base, &e_dummy)
+			&& XSyncInitialize(display.dpy, &major, &minor);
+		if (!display.have_xsync) {
+			LOG_DEBUG("XSync is not supported on this display.\n");
+		}
+	}
+#endif
 
 	// Initialise screens
 	display.nscreens = ScreenCount(display.dpy);
@@ -209,6 +226,9 @@ void display_close(void) {
 }
 
 void display_manage_clients(void) {
+	long long start_us = get_time_us();
+
+	display.adopted_clients = 0;
 	for (int i = 0; i < display.nscreens; i++) {
 		struct screen *s = &display.screens[i];
 
@@ -220,20 +240,14 @@ void display_manage_clients(void) {
 		LOG_XLEAVE();
 
 		// Manage all relevant windows
-		for (unsigned j = 0; j < nwins; j++) {
-			XWindowAttributes winattr;
-			XGetWindowAttributes(display.dpy, wins[j], &winattr);
-			// Override redirect implies a pop-up that we should ignore.
-			// If map_state is not IsViewable, it shouldn't be shown right
-			// now, so don't try to manage it.
-			if (!winattr.override_redirect && winattr.map_state == IsViewable)
-				client_manage_new(wins[j], s);
-		}
+		display.adopted_clients += client_manage_existing(s, wins, nwins);
 		XFree(wins);
 	}
+	display.adopt_us = get_time_us() - start_us;
+	LOG_DEBUG("adopted %u windows in %lldus\n", display.adopted_clients, display.adopt_us);
 }
 
 void display_unmanage_clients(void) {
-	while (clients_stacking_order)
-		remove_client(clients_stacking_order->data);
+	while (clients_stacking_order.head)
+		remove_client(clients_stacking_order.head);
 }
@@ -73,6 +73,10 @@ enum {
 	X_ATOM__NET_WM_PID,
 	X_ATOM__NET_FRAME_EXTENTS,
 
+	// EWMH: Window Manager Protocols
+	X_ATOM__NET_WM_SYNC_REQUEST,
+	X_ATOM__NET_WM_SYNC_REQUEST_COUNTER,
+
 	NUM_ATOMS
 };
 
@@ -101,6 +105,10 @@ struct display {
 	Bool have_randr;
 	int randr_event_base;
 #endif
+#ifdef XSYNC
+	Bool have_xsync;
+	int xsync_event_base;
+#endif
 
 	// Screens
 	int nscreens;
@@ -110,6 +118,11 @@ struct display {
 #ifdef INFOBANNER
 	Window info_window;
 #endif
+
+	// Windows adopted by the last display_manage_clients(), and how long
+	// it took
+	unsigned adopted_clients;
+	long long adopt_us;
 };
 
 // evilwm only supports one display at a time; this variable is global:
@@ -27,9 +27,10 @@
 #include "events.h"
 #include "evilwm.h"
 #include "ewmh.h"
-#include "list.h"
 #include "log.h"
+#include "loop.h"
 #include "screen.h"
+#include "stats.h"
 #include "util.h"
 
 // Event loop will run until this flag is set
@@ -186,9 +187,10 @@ static void handle_map_request(XMapRequestEvent *e) {
 		client_show(c);
 		client_raise(c);
 	} else {
-		XWindowAttributes attr;
-		XGetWindowAttributes(display.dpy, e->window, &attr);
-		client_manage_new(e->window, find_screen(attr.root));
+		// Only map requests on a root window are redirected to us
+		struct screen *s = find_screen(e->parent);
+		if (s)
+			client_manage_new(e->window, s);
 	}
 	LOG_LEAVE();
 }
@@ -224,6 +226,15 @@ static void handle_colormap_change(XColormapEvent *e) {
 static void handle_property_change(XPropertyEvent *e) {
 	struct client *c = find_client(e->window);
 
+	// Stop watching an unmanaged window once its cached border is
+	// stale.  It is watched again if it asks for its frame extents.
+	if (!c && e->atom == X_ATOM(_MOTIF_WM_HINTS)
+	    && forget_window_normal_border(e->window)) {
+		xerror_expect_begin(e->window);
+		XSelectInput(display.dpy, e->window, NoEventMask);
+		xerror_expect_end();
+	}
+
 	if (c) {
 		LOG_ENTER("handle_property_change(window=%lx, atom=%s)", (unsigned long)e->window, debug_atom_name(e->atom));
 		if (e->atom == XA_WM_NORMAL_HINTS) {
@@ -242,11 +253,15 @@ static void handle_property_change(XPropertyEvent *e) {
 static void handle_enter_event(XCrossingEvent *e) {
 	struct client *c;
 
+	if (enter_event_discarded(e)) {
+		LOG_DEBUG("discarding enter event for window=%lx\n", (unsigned long)e->window);
+		return;
+	}
 	if ((c = find_client(e->window))) {
 		if (!is_fixed(c) && c->vdesk != c->screen->vdesk)
 			return;
 		select_client(c);
-		clients_tab_order = list_to_head(clients_tab_order, c);
+		client_list_to_head(&clients_tab_order, c);
 	}
 }
 
@@ -279,7 +294,9 @@ static void handle_randr_event(XRRScreenChangeNotifyEvent *e) {
 	screen_probe_monitors(s);
 	// Fix any clients that are now not visible on any monitor.  Also
 	// adjusts maximised geometries where appropriate.
-	fix_screen_after_resize(s);
+	unsigned moved = fix_screen_after_resize(s);
+	LOG_DEBUG("screen %d: %d monitors, moved %u clients\n", s->screen, s->nmonitors, moved);
+	(void)moved;
 	// Update various EWMH properties that reflect screen geometry
 	ewmh_set_screen_workarea(s);
 }
@@ -308,7 +325,7 @@ static void handle_client_message(XClientMessageEvent *e) {
 		// thing that affects this for us is MWM hints.
 
 		if (e->message_type == X_ATOM(_NET_REQUEST_FRAME_EXTENTS)) {
-			int bw = window_normal_border(e->window);
+			int bw = pending_window_normal_border(e->window);
 			ewmh_set_net_frame_extents(e->window, bw);
 		}
 
@@ -397,6 +414,136 @@ static void handle_client_message(XClientMessageEvent *e) {
 	LOG_LEAVE();
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// Coalescing of queued events.  When an event is dequeued, later events that
+// supersede it are pulled forward to replace it, so a client spamming
+// requests only costs one round of handling.
+
+// The window an event concerns.  For structure events this is not the window
+// the event was reported on (xany.window).
+
+static Window event_subject(XEvent *ev) {
+	switch (ev->type) {
+	case ConfigureRequest: return ev->xconfigurerequest.window;
+	case MapRequest: return ev->xmaprequest.window;
+	case UnmapNotify: return ev->xunmap.window;
+	case DestroyNotify: return ev->xdestroywindow.window;
+	case MapNotify: return ev->xmap.window;
+	case ReparentNotify: return ev->xreparent.window;
+	case ConfigureNotify: return ev->xconfigure.window;
+	case GravityNotify: return ev->xgravity.window;
+	case CirculateRequest: return ev->xcirculaterequest.window;
+	default: break;
+	}
+	return ev->xany.window;
+}
+
+// Limit on how many queued events one scan looks at, so that coalescing stays
+// cheap however long the queue gets.
+#define COALESCE_SCAN_LIMIT 32
+
+struct coalesce {
+	XEvent *ev;       // event being replaced
+	unsigned nscan;   // events looked at so far
+	_Bool barrier;    // scan reached an event that must not be reordered
+};
+
+// Common to the predicates: stop scanning at a barrier or the scan limit.
+
+static _Bool coalesce_stop(struct coalesce *co) {
+	if (co->barrier)
+		return 1;
+	if (++co->nscan > COALESCE_SCAN_LIMIT) {
+		co->barrier = 1;
+		return 1;
+	}
+	return 0;
+}
+
+// Predicate functions for use with XCheckIfEvent.  Each matches the first
+// queued event that supersedes the one being handled, so each merge only
+// scans as far as the next match.
+//
+// A later ConfigureRequest for the same window with the same value mask
+// supersedes an earlier one.  A request with a different mask might rely on
+// the first having been applied (e.g. a gravity-relative resize following a
+// move), so it, or any other event concerning the window, ends the scan.
+
+static Bool predicate_configure_request(Display *dummy, XEvent *ev, XPointer arg) {
+	(void)dummy;
+	struct coalesce *co = (struct coalesce *)arg;
+	XConfigureRequestEvent *e = &co->ev->xconfigurerequest;
+	if (coalesce_stop(co) || event_subject(ev) != e->window)
+		return False;
+	if (ev->type != ConfigureRequest || ev->xconfigurerequest.value_mask != e->value_mask) {
+		co->barrier = 1;
+		return False;
+	}
+	return True;
+}
+
+// Property values are read when the event is handled, so a later change to
+// the same property can always replace an earlier one.
+
+static Bool predicate_property(Display *dummy, XEvent *ev, XPointer arg) {
+	(void)dummy;
+	struct coalesce *co = (struct coalesce *)arg;
+	if (coalesce_stop(co))
+		return False;
+	return ev->type == PropertyNotify
+	       && ev->xproperty.window == co->ev->xproperty.window
+	       && ev->xproperty.atom == co->ev->xproperty.atom;
+}
+
+// Only the last of a run of enter events matters.  Nearly anything else can
+// change focus or what is visible, so only adjacent enter events are merged.
+
+static Bool predicate_enter(Display *dummy, XEvent *ev, XPointer arg) {
+	(void)dummy;
+	struct coalesce *co = (struct coalesce *)arg;
+	if (coalesce_stop(co))
+		return False;
+	if (ev->type != EnterNotify) {
+		co->barrier = 1;
+		return False;
+	}
+	return True;
+}
+
+// Replace an event with any queued events superseding it.  How many were
+// merged is logged, and counted for the stats dump.
+
+static void coalesce_event(XEvent *ev) {
+	Bool (*predicate)(Display *, XEvent *, XPointer);
+	XEvent next;
+	unsigned n = 0;
+
+	switch (ev->type) {
+	case ConfigureRequest: predicate = predicate_configure_request; break;
+	case PropertyNotify: predicate = predicate_property; break;
+	case EnterNotify: predicate = predicate_enter; break;
+	default: return;
+	}
+
+	for (;;) {
+		struct coalesce co = { .ev = ev, .nscan = 0, .barrier = 0 };
+		if (!XCheckIfEvent(display.dpy, &next, predicate, (XPointer)&co))
+			break;
+		*ev = next;
+		n++;
+	}
+
+	if (n) {
+		LOG_DEBUG("coalesced %u events into type %d for window=%lx\n", n, ev->type, (unsigned long)event_subject(ev));
+		switch (ev->type) {
+		case ConfigureRequest: stats_count(configure_coalesced, n); break;
+		case PropertyNotify: stats_count(property_coalesced, n); break;
+		default: stats_count(enter_coalesced, n); break;
+		}
+	}
+}
+
 // Run the main event loop.  This will run until something tells us to quit
 // (generally, a signal).
 
@@ -415,7 +562,14 @@ void event_main_loop(void) {
 
 	// Main event loop
 	while (!end_event_loop) {
-		if (interruptibleXNextEvent(&ev.xevent)) {
+		// Root window properties changed while handling events are
+		// only written out once the event queue has been drained.
+		if (!XEventsQueued(display.dpy, QueuedAlready))
+			ewmh_update_root_properties();
+
+		if (loop_next_event(&ev.xevent)) {
+			stats_event_begin(&ev.xevent);
+			coalesce_event(&ev.xevent);
 			switch (ev.xevent.type) {
 			case KeyPress:
 				bind_handle_key(&ev.xevent.xkey);
@@ -450,6 +604,9 @@ void event_main_loop(void) {
 			case ClientMessage:
 				handle_client_message(&ev.xevent.xclient);
 				break;
+			case DestroyNotify:
+				forget_window_normal_border(ev.xevent.xdestroywindow.window);
+				break;
 			default:
 #ifdef SHAPE
 				if (display.have_shape
@@ -464,18 +621,13 @@ void event_main_loop(void) {
 #endif
 				break;
 			}
+			stats_event_end();
 		}
 
 		// Scan list for clients flagged to be removed
 		if (need_client_tidy) {
-			struct list *iter, *niter;
 			need_client_tidy = 0;
-			for (iter = clients_tab_order; iter; iter = niter) {
-				struct client *c = iter->data;
-				niter = iter->next;
-				if (c->remove)
-					remove_client(c);
-			}
+			remove_flagged_clients();
 		}
 	}
 }
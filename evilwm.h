@@ -39,12 +39,27 @@ struct options {
 	// Snap to border flag
 	int snap;
 
+	// Maximum window moves per second while dragging (0 = unlimited)
+	int dragrate;
+
+	// Minimum milliseconds between ConfigureNotify events sent to a client
+	// while it's being dragged (0 = no limit)
+	int configdelay;
+
 	// Whole screen flag (ignore monitor information)
 	int wholescreen;
 
 #ifdef SOLIDDRAG
 	// Solid drag disabled flag
 	int no_solid_drag;
+
+	// Solid resize enabled flag
+	int solid_resize;
+#endif
+
+#ifdef STATS
+	// File to write event statistics to on SIGUSR1
+	char *statsfile;
 #endif
 
 	// NULL-terminated array passed to execvp() to launch terminal
@@ -55,8 +70,10 @@ extern struct options option;
 
 #ifdef SOLIDDRAG
 # define OPTION_NO_SOLID_DRAG (option.no_solid_drag)
+# define OPTION_SOLID_RESIZE (option.solid_resize && !option.no_solid_drag)
 #else
 # define OPTION_NO_SOLID_DRAG (1)
+# define OPTION_SOLID_RESIZE (0)
 #endif
 
 extern unsigned numlockmask;
@@ -9,6 +9,7 @@
 #endif
 
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <X11/X.h>
@@ -18,21 +19,33 @@
 #include "display.h"
 #include "evilwm.h"
 #include "ewmh.h"
-#include "list.h"
 #include "log.h"
 #include "screen.h"
 #include "util.h"
 
-// Maintain a reasonably sized allocated block of memory for lists
-// of windows (for feeding to XChangeProperty in one hit).
-static Window *window_array = NULL;
-static Window *alloc_window_array(void);
-
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
-// Update various properties that reflect the screen geometry.
+// Root window properties can change many times while handling a burst of
+// events (e.g., many clients being mapped at once).  The functions called as
+// things change just flag which properties need updating, and
+// ewmh_update_root_properties() is called from the event loop once the event
+// queue has been drained to write them out.
+
+// Flag properties that reflect the screen geometry for update.
 
 void ewmh_set_screen_workarea(struct screen *s) {
+	s->ewmh_dirty |= EWMH_DIRTY_WORKAREA;
+}
+
+// Flag _NET_CURRENT_DESKTOP for update.
+
+void ewmh_set_net_current_desktop(struct screen *s) {
+	s->ewmh_dirty |= EWMH_DIRTY_CURRENT_DESKTOP;
+}
+
+// Update various properties that reflect the screen geometry.
+
+static void update_screen_workarea(struct screen *s) {
 	// All our virtual desktops are the same, but we need to report a
 	// workarea for each one:
 	int ndesktops = option.vdeskrows * option.vdeskcolumns;
@@ -69,50 +82,63 @@ void ewmh_set_screen_workarea(struct screen *s) {
 // Update the _NET_CLIENT_LIST property for a screen.  This is a simple list of
 // all client windows in the order they were mapped.
 
-void ewmh_set_net_client_list(struct screen *s) {
-	Window *windows = alloc_window_array();
-	int i = 0;
-	if (windows) {
-		for (struct list *iter = clients_mapping_order; iter; iter = iter->next) {
-			struct client *c = iter->data;
-			if (c->screen == s) {
-				windows[i++] = c->window;
-			}
-		}
-	}
+static void update_net_client_list(struct screen *s) {
 	XChangeProperty(display.dpy, s->root, X_ATOM(_NET_CLIENT_LIST),
 			XA_WINDOW, 32, PropModeReplace,
-			(unsigned char *)windows, i);
+			(unsigned char *)s->client_list.windows,
+			s->client_list.nwindows);
 }
 
 // Update the _NET_CLIENT_LIST_STACKING property for a screen.  Similar to
 // _NET_CLIENT_LIST, but in stacking order (bottom to top).
 
-void ewmh_set_net_client_list_stacking(struct screen *s) {
-	Window *windows = alloc_window_array();
-	int i = 0;
-	if (windows) {
-		for (struct list *iter = clients_stacking_order; iter; iter = iter->next) {
-			struct client *c = iter->data;
-			if (c->screen == s) {
-				windows[i++] = c->window;
-			}
-		}
-	}
+static void update_net_client_list_stacking(struct screen *s) {
 	XChangeProperty(display.dpy, s->root, X_ATOM(_NET_CLIENT_LIST_STACKING),
 			XA_WINDOW, 32, PropModeReplace,
-			(unsigned char *)windows, i);
+			(unsigned char *)s->client_list_stacking.windows,
+			s->client_list_stacking.nwindows);
 }
 
 // Update _NET_CURRENT_DESKTOP for screen to currently selected vdesk.
 
-void ewmh_set_net_current_desktop(struct screen *s) {
+static void update_net_current_desktop(struct screen *s) {
 	unsigned long vdesk = s->vdesk;
 	XChangeProperty(display.dpy, s->root, X_ATOM(_NET_CURRENT_DESKTOP),
 			XA_CARDINAL, 32, PropModeReplace,
 			(unsigned char *)&vdesk, 1);
 }
 
+// Update _NET_ACTIVE_WINDOW for screen to the window last recorded as
+// active.
+
+static void update_net_active_window(struct screen *s) {
+	XChangeProperty(display.dpy, s->root, X_ATOM(_NET_ACTIVE_WINDOW),
+			XA_WINDOW, 32, PropModeReplace,
+			(unsigned char *)&s->active, 1);
+}
+
+// Write out any root window properties flagged as needing an update.
+
+void ewmh_update_root_properties(void) {
+	for (int i = 0; i < display.nscreens; i++) {
+		struct screen *s = &display.screens[i];
+		unsigned dirty = s->ewmh_dirty;
+		if (!dirty)
+			continue;
+		s->ewmh_dirty = 0;
+		if (dirty & EWMH_DIRTY_CLIENT_LIST)
+			update_net_client_list(s);
+		if (dirty & EWMH_DIRTY_CLIENT_LIST_STACKING)
+			update_net_client_list_stacking(s);
+		if (dirty & EWMH_DIRTY_ACTIVE_WINDOW)
+			update_net_active_window(s);
+		if (dirty & EWMH_DIRTY_CURRENT_DESKTOP)
+			update_net_current_desktop(s);
+		if (dirty & EWMH_DIRTY_WORKAREA)
+			update_screen_workarea(s);
+	}
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
 // Set the _NET_WM_ALLOWED_ACTIONS on a client advertising what we support.
@@ -177,20 +203,27 @@ unsigned ewmh_get_net_wm_window_type(Window w) {
 	unsigned type = 0;
 	if ( (aprop = get_property(w, X_ATOM(_NET_WM_WINDOW_TYPE), XA_ATOM, &nitems)) ) {
 		for (i = 0; i < nitems; i++) {
-			if (aprop[i] == X_ATOM(_NET_WM_WINDOW_TYPE_DESKTOP))
-				type |= EWMH_WINDOW_TYPE_DESKTOP;
-			if (aprop[i] == X_ATOM(_NET_WM_WINDOW_TYPE_DOCK))
-				type |= EWMH_WINDOW_TYPE_DOCK;
-			if (aprop[i] == X_ATOM(_NET_WM_WINDOW_TYPE_NOTIFICATION))
-				type |= EWMH_WINDOW_TYPE_NOTIFICATION;
+			type |= ewmh_window_type_flag(aprop[i]);
 		}
 		XFree(aprop);
 	}
 	return type;
 }
 
-// Update _NET_WM_STATE_* properties on a window.  Also updates
-// _NET_ACTIVE_WINDOW on the client's screen if necessary.
+// Map a single _NET_WM_WINDOW_TYPE atom to the flag we track for it, if any.
+
+unsigned ewmh_window_type_flag(Atom type) {
+	if (type == X_ATOM(_NET_WM_WINDOW_TYPE_DESKTOP))
+		return EWMH_WINDOW_TYPE_DESKTOP;
+	if (type == X_ATOM(_NET_WM_WINDOW_TYPE_DOCK))
+		return EWMH_WINDOW_TYPE_DOCK;
+	if (type == X_ATOM(_NET_WM_WINDOW_TYPE_NOTIFICATION))
+		return EWMH_WINDOW_TYPE_NOTIFICATION;
+	return 0;
+}
+
+// Update _NET_WM_STATE_* properties on a window.  Also flags
+// _NET_ACTIVE_WINDOW on the client's screen for update if necessary.
 
 void ewmh_set_net_wm_state(struct client *c) {
 	Atom state[4];
@@ -205,18 +238,12 @@ void ewmh_set_net_wm_state(struct client *c) {
 		state[i++] = X_ATOM(_NET_WM_STATE_FOCUSED);
 	if (c == current) {
 		if (c->screen->active != c->window) {
-			XChangeProperty(display.dpy, c->screen->root,
-			                X_ATOM(_NET_ACTIVE_WINDOW),
-			                XA_WINDOW, 32, PropModeReplace,
-			                (unsigned char *)&c->window, 1);
 			c->screen->active = c->window;
+			c->screen->ewmh_dirty |= EWMH_DIRTY_ACTIVE_WINDOW;
 		}
 	} else if (c->screen->active == c->window) {
-		Window w = None;
-		XChangeProperty(display.dpy, c->screen->root, X_ATOM(_NET_ACTIVE_WINDOW),
-		                XA_WINDOW, 32, PropModeReplace,
-		                (unsigned char *)&w, 1);
 		c->screen->active = None;
+		c->screen->ewmh_dirty |= EWMH_DIRTY_ACTIVE_WINDOW;
 	}
 	XChangeProperty(display.dpy, c->window, X_ATOM(_NET_WM_STATE),
 			XA_ATOM, 32, PropModeReplace,
@@ -238,19 +265,108 @@ void ewmh_set_net_frame_extents(Window w, unsigned long border) {
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
-// Allocate/resize an array suitable to hold all client window ids.
-//
-// XXX should test that this can be allocated before we commit to managing a
-// window, in the same way that we test the client structure allocation.
+// The window arrays used for _NET_CLIENT_LIST and _NET_CLIENT_LIST_STACKING
+// are maintained incrementally, so updating either property is a single
+// XChangeProperty() of an array that is already built.
 
-static Window *alloc_window_array(void) {
-	unsigned count = 0;
-	for (struct list *iter = clients_mapping_order; iter; iter = iter->next) {
-		count++;
+// Find window in array, searching from the top (end), as that's where
+// restacked windows generally are.  Returns nwindows if not found.
+
+static unsigned window_array_find(struct window_array *wa, Window w) {
+	for (unsigned i = wa->nwindows; i > 0; i--) {
+		if (wa->windows[i-1] == w)
+			return i - 1;
+	}
+	return wa->nwindows;
+}
+
+static void window_array_delete(struct window_array *wa, unsigned i) {
+	if (i >= wa->nwindows)
+		return;
+	wa->nwindows--;
+	memmove(&wa->windows[i], &wa->windows[i+1], (wa->nwindows - i) * sizeof(Window));
+}
+
+// Ensure arrays can hold another client.  This is called before committing
+// to managing a new window, so a failure to allocate here just means the
+// window isn't managed.
+
+static _Bool window_array_reserve(struct window_array *wa) {
+	if (wa->nwindows < wa->size)
+		return 1;
+	// Grow in blocks of 128
+	unsigned size = (wa->nwindows + 128) & ~127;
+	Window *windows = realloc(wa->windows, size * sizeof(Window));
+	if (!windows)
+		return 0;
+	wa->windows = windows;
+	wa->size = size;
+	return 1;
+}
+
+_Bool ewmh_client_list_reserve(struct screen *s) {
+	return window_array_reserve(&s->client_list)
+	       && window_array_reserve(&s->client_list_stacking);
+}
+
+// New client: append to the mapping order and to the top of the stacking
+// order.  ewmh_client_list_reserve() must have been called first.
+
+void ewmh_client_list_add(struct client *c) {
+	struct screen *s = c->screen;
+	s->client_list.windows[s->client_list.nwindows++] = c->window;
+	s->client_list_stacking.windows[s->client_list_stacking.nwindows++] = c->window;
+	s->ewmh_dirty |= EWMH_DIRTY_CLIENT_LIST | EWMH_DIRTY_CLIENT_LIST_STACKING;
+}
+
+void ewmh_client_list_remove(struct client *c) {
+	struct screen *s = c->screen;
+	window_array_delete(&s->client_list, window_array_find(&s->client_list, c->window));
+	window_array_delete(&s->client_list_stacking, window_array_find(&s->client_list_stacking, c->window));
+	s->ewmh_dirty |= EWMH_DIRTY_CLIENT_LIST | EWMH_DIRTY_CLIENT_LIST_STACKING;
+}
+
+// Drop windows that are no longer managed from both arrays in one pass each.
+// Used after withdrawing several clients at once.
+
+static void window_array_purge(struct window_array *wa) {
+	unsigned j = 0;
+	for (unsigned i = 0; i < wa->nwindows; i++) {
+		if (find_client(wa->windows[i]))
+			wa->windows[j++] = wa->windows[i];
 	}
-	if (count == 0) count++;
-	// Round up to next block of 128
-	count = (count + 127) & ~127;
-	window_array = realloc(window_array, count * sizeof(Window));
-	return window_array;
+	wa->nwindows = j;
+}
+
+void ewmh_client_list_purge(struct screen *s) {
+	unsigned n = s->client_list.nwindows;
+	window_array_purge(&s->client_list);
+	if (s->client_list.nwindows == n)
+		return;
+	window_array_purge(&s->client_list_stacking);
+	s->ewmh_dirty |= EWMH_DIRTY_CLIENT_LIST | EWMH_DIRTY_CLIENT_LIST_STACKING;
+}
+
+// Move client to top of stacking order.
+
+void ewmh_client_list_raise(struct client *c) {
+	struct window_array *wa = &c->screen->client_list_stacking;
+	unsigned i = window_array_find(wa, c->window);
+	if (i >= wa->nwindows)
+		return;
+	memmove(&wa->windows[i], &wa->windows[i+1], (wa->nwindows - i - 1) * sizeof(Window));
+	wa->windows[wa->nwindows - 1] = c->window;
+	c->screen->ewmh_dirty |= EWMH_DIRTY_CLIENT_LIST_STACKING;
+}
+
+// Move client to bottom of stacking order.
+
+void ewmh_client_list_lower(struct client *c) {
+	struct window_array *wa = &c->screen->client_list_stacking;
+	unsigned i = window_array_find(wa, c->window);
+	if (i >= wa->nwindows)
+		return;
+	memmove(&wa->windows[1], &wa->windows[0], i * sizeof(Window));
+	wa->windows[0] = c->window;
+	c->screen->ewmh_dirty |= EWMH_DIRTY_CLIENT_LIST_STACKING;
 }
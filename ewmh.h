@@ -16,13 +16,27 @@
 #define EWMH_WINDOW_TYPE_DOCK    (1<<1)
 #define EWMH_WINDOW_TYPE_NOTIFICATION (1<<2)
 
+// Root window properties that need updating.  Changes are only flagged as
+// they happen; ewmh_update_root_properties() writes them out.
+#define EWMH_DIRTY_CLIENT_LIST          (1<<0)
+#define EWMH_DIRTY_CLIENT_LIST_STACKING (1<<1)
+#define EWMH_DIRTY_ACTIVE_WINDOW        (1<<2)
+#define EWMH_DIRTY_CURRENT_DESKTOP      (1<<3)
+#define EWMH_DIRTY_WORKAREA             (1<<4)
+
 struct client;
 struct screen;
 
 void ewmh_set_screen_workarea(struct screen *s);
-void ewmh_set_net_client_list(struct screen *s);
-void ewmh_set_net_client_list_stacking(struct screen *s);
 void ewmh_set_net_current_desktop(struct screen *s);
+void ewmh_update_root_properties(void);
+
+_Bool ewmh_client_list_reserve(struct screen *s);
+void ewmh_client_list_add(struct client *c);
+void ewmh_client_list_remove(struct client *c);
+void ewmh_client_list_purge(struct screen *s);
+void ewmh_client_list_raise(struct client *c);
+void ewmh_client_list_lower(struct client *c);
 
 void ewmh_set_allowed_actions(struct client *c);
 void ewmh_remove_allowed_actions(struct client *c);
@@ -30,6 +44,7 @@ void ewmh_withdraw_client(struct client *c);
 
 void ewmh_set_net_wm_desktop(struct client *c);
 unsigned ewmh_get_net_wm_window_type(Window w);
+unsigned ewmh_window_type_flag(Atom type);
 void ewmh_set_net_wm_state(struct client *c);
 void ewmh_set_net_frame_extents(Window w, unsigned long border);
 
@@ -21,9 +21,9 @@
 #include "display.h"
 #include "evilwm.h"
 #include "func.h"
-#include "list.h"
 #include "log.h"
 #include "screen.h"
+#include "stats.h"
 #include "util.h"
 
 static void do_client_move(struct client *c) {
@@ -136,7 +136,7 @@ void func_next(void *sptr, XEvent *e, unsigned flags) {
 		return;
 	XKeyEvent *xkey = (XKeyEvent *)e;
 	client_select_next();
-	if (XGrabKeyboard(display.dpy, xkey->root, False, GrabModeAsync, GrabModeAsync, CurrentTime) == GrabSuccess) {
+	if (grab_keyboard(xkey->root)) {
 		XEvent ev;
 		do {
 			XMaskEvent(display.dpy, KeyPressMask|KeyReleaseMask, &ev);
@@ -145,7 +145,7 @@ void func_next(void *sptr, XEvent *e, unsigned flags) {
 		} while (ev.type == KeyPress || ev.xkey.keycode == xkey->keycode);
 		XUngrabKeyboard(display.dpy, CurrentTime);
 	}
-	clients_tab_order = list_to_head(clients_tab_order, current);
+	client_list_to_head(&clients_tab_order, current);
 }
 
 void func_raise(void *sptr, XEvent *e, unsigned flags) {
@@ -0,0 +1,281 @@
+/* evilwm - minimalist window manager for X11
+ * Copyright (C) 1999-2025 Ciaran Anscomb <evilwm@6809.org.uk>
+ * see README for license and other details. */
+
+// Main loop core.  See loop.h.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <X11/X.h>
+#include <X11/Xlib.h>
+
+#include "display.h"
+#include "log.h"
+#include "loop.h"
+#include "util.h"
+#include "xalloc.h"
+
+#define MAX_SIGNALS 8
+
+struct loop_timer {
+	long long at_us;
+	unsigned id;
+	loop_timer_func func;
+	void *data;
+};
+
+// Signal handlers set the flag, and write to one end of this pipe so that a
+// poll() on the other wakes up.  The flag is cheap enough to check before
+// returning every event.
+static volatile sig_atomic_t signal_pending = 0;
+static int signal_pipe[2] = { -1, -1 };
+
+static struct {
+	int signo;
+	void (*func)(int);
+	volatile sig_atomic_t caught;
+} signals[MAX_SIGNALS];
+static int nsignals = 0;
+
+// Binary min-heap of timers, earliest deadline at index 0.
+static struct loop_timer *timers = NULL;
+static unsigned ntimers = 0;
+static unsigned timers_size = 0;
+static unsigned next_timer_id = 1;
+
+// Only async-signal-safe calls in here.
+
+static void loop_signal_handler(int signo) {
+	int saved_errno = errno;
+	unsigned char b = signo;
+	for (int i = 0; i < nsignals; i++) {
+		if (signals[i].signo == signo)
+			signals[i].caught = 1;
+	}
+	signal_pending = 1;
+	if (signal_pipe[1] >= 0) {
+		ssize_t r = write(signal_pipe[1], &b, 1);
+		(void)r;  // pipe full: a wakeup is already pending
+	}
+	errno = saved_errno;
+}
+
+static void set_pipe_flags(int fd) {
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+}
+
+void loop_signal(int signo, void (*func)(int)) {
+	struct sigaction act;
+
+	// Without the pipe, signals are still caught, but are only noticed
+	// once poll() is interrupted or an event arrives.
+	if (signal_pipe[0] < 0) {
+		if (pipe(signal_pipe) < 0) {
+			LOG_ERROR("loop_signal(): pipe()\n");
+			signal_pipe[0] = signal_pipe[1] = -1;
+		} else {
+			set_pipe_flags(signal_pipe[0]);
+			set_pipe_flags(signal_pipe[1]);
+		}
+	}
+	if (nsignals >= MAX_SIGNALS)
+		return;
+	signals[nsignals].signo = signo;
+	signals[nsignals].func = func;
+	signals[nsignals].caught = 0;
+	nsignals++;
+
+	act.sa_handler = loop_signal_handler;
+	sigemptyset(&act.sa_mask);
+	act.sa_flags = 0;
+	sigaction(signo, &act, NULL);
+}
+
+// Call the function for every signal caught since the last call, and empty
+// the wakeup pipe.  Returns the number dispatched.
+
+static int dispatch_signals(void) {
+	unsigned char buf[16];
+	int count = 0;
+	if (!signal_pending)
+		return 0;
+	signal_pending = 0;
+	if (signal_pipe[0] >= 0) {
+		while (read(signal_pipe[0], buf, sizeof(buf)) > 0)
+			;
+	}
+	for (int i = 0; i < nsignals; i++) {
+		if (signals[i].caught) {
+			signals[i].caught = 0;
+			signals[i].func(signals[i].signo);
+			count++;
+		}
+	}
+	return count;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// Timer heap maintenance
+
+static void timer_swap(unsigned a, unsigned b) {
+	struct loop_timer t = timers[a];
+	timers[a] = timers[b];
+	timers[b] = t;
+}
+
+static void timer_sift_up(unsigned i) {
+	while (i > 0) {
+		unsigned parent = (i - 1) / 2;
+		if (timers[parent].at_us <= timers[i].at_us)
+			break;
+		timer_swap(parent, i);
+		i = parent;
+	}
+}
+
+static void timer_sift_down(unsigned i) {
+	for (;;) {
+		unsigned l = 2 * i + 1, r = l + 1, min = i;
+		if (l < ntimers && timers[l].at_us < timers[min].at_us)
+			min = l;
+		if (r < ntimers && timers[r].at_us < timers[min].at_us)
+			min = r;
+		if (min == i)
+			break;
+		timer_swap(i, min);
+		i = min;
+	}
+}
+
+static void timer_delete(unsigned i) {
+	ntimers--;
+	if (i == ntimers)
+		return;
+	timers[i] = timers[ntimers];
+	timer_sift_down(i);
+	timer_sift_up(i);
+}
+
+unsigned loop_timer_add(long long at_us, loop_timer_func func, void *data) {
+	if (ntimers >= timers_size) {
+		timers_size = timers_size ? timers_size * 2 : 8;
+		timers = xrealloc(timers, timers_size * sizeof(struct loop_timer));
+	}
+	unsigned id = next_timer_id++;
+	if (next_timer_id == 0)
+		next_timer_id = 1;
+	timers[ntimers] = (struct loop_timer){ .at_us = at_us, .id = id, .func = func, .data = data };
+	timer_sift_up(ntimers++);
+	return id;
+}
+
+void loop_timer_cancel(unsigned id) {
+	for (unsigned i = 0; i < ntimers; i++) {
+		if (timers[i].id == id) {
+			timer_delete(i);
+			return;
+		}
+	}
+}
+
+// Run every timer that is due.  Each is removed from the heap before being
+// called, so it may add or cancel timers itself.  Returns the number run.
+
+static int run_timers(void) {
+	long long now = get_time_us();
+	int count = 0;
+	while (ntimers > 0 && timers[0].at_us <= now) {
+		struct loop_timer t = timers[0];
+		timer_delete(0);
+		t.func(t.data);
+		count++;
+	}
+	return count;
+}
+
+// Milliseconds until the earliest timer, rounded up, or -1 for none.
+
+static int next_timeout_ms(void) {
+	if (ntimers == 0)
+		return -1;
+	long long us = timers[0].at_us - get_time_us();
+	if (us <= 0)
+		return 0;
+	long long ms = (us + 999) / 1000;
+	return ms > INT_MAX ? INT_MAX : (int)ms;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// Wait for data from the X server, a signal or the next timer, for no longer
+// than timeout_us (negative for no limit).  Returns the number of descriptors
+// with data.
+
+static int poll_display(long long timeout_us) {
+	struct pollfd fds[2];
+	nfds_t nfds = 1;
+	int timeout = next_timeout_ms();
+
+	if (timeout_us >= 0) {
+		long long ms = (timeout_us + 999) / 1000;
+		if (ms > INT_MAX)
+			ms = INT_MAX;
+		if (timeout < 0 || ms < timeout)
+			timeout = (int)ms;
+	}
+
+	fds[0].fd = ConnectionNumber(display.dpy);
+	fds[0].events = POLLIN;
+	if (signal_pipe[0] >= 0) {
+		fds[1].fd = signal_pipe[0];
+		fds[1].events = POLLIN;
+		nfds = 2;
+	}
+
+	int rc = poll(fds, nfds, timeout);
+	if (rc < 0 && errno != EINTR) {
+		LOG_ERROR("poll_display(): poll()\n");
+	}
+	return rc;
+}
+
+int loop_next_event(XEvent *event) {
+	for (;;) {
+		// Signals take priority over queued events
+		if (dispatch_signals() > 0)
+			return 0;
+		// XPending() also flushes any requests not yet sent
+		if (XPending(display.dpy)) {
+			XNextEvent(display.dpy, event);
+			return 1;
+		}
+		if (run_timers() > 0)
+			return 0;
+		poll_display(-1);
+	}
+}
+
+_Bool loop_wait(long long timeout_us) {
+	long long until_us = get_time_us() + timeout_us;
+	XFlush(display.dpy);
+	for (;;) {
+		if (dispatch_signals() > 0 || run_timers() > 0)
+			return 1;
+		long long left_us = -1;
+		if (timeout_us >= 0 && (left_us = until_us - get_time_us()) <= 0)
+			return 0;
+		if (poll_display(left_us) > 0 && !signal_pending)
+			return 1;
+	}
+}
@@ -0,0 +1,41 @@
+/* evilwm - minimalist window manager for X11
+ * Copyright (C) 1999-2025 Ciaran Anscomb <evilwm@6809.org.uk>
+ * see README for license and other details. */
+
+// Main loop core.
+//
+// Waits on the X connection for events, while also running timers and
+// dispatching signals.  Signal handlers only write the signal number to a
+// pipe; the function registered for it is called later from the loop, so it
+// may do anything.  Timers are kept in a heap ordered by deadline.
+
+#ifndef EVILWM_LOOP_H_
+#define EVILWM_LOOP_H_
+
+#include <X11/X.h>
+#include <X11/Xlib.h>
+
+typedef void (*loop_timer_func)(void *data);
+
+// Catch signal signo.  func is called from loop_next_event().
+void loop_signal(int signo, void (*func)(int));
+
+// Call func(data) once get_time_us() reaches at_us.  Returns an id that can
+// be passed to loop_timer_cancel().  Ids are never zero.
+unsigned loop_timer_add(long long at_us, loop_timer_func func, void *data);
+
+// Cancel a timer that has not yet run.  Unknown ids are ignored.
+void loop_timer_cancel(unsigned id);
+
+// Wait for the next X event.  Due timers and caught signals are dispatched
+// first, in which case this returns 0 without an event, so that the caller
+// can check whether it should still be running.
+int loop_next_event(XEvent *event);
+
+// Wait up to timeout_us microseconds (negative for no limit) for more data
+// from the X server.  Returns early if a timer or signal was dispatched
+// meanwhile.  Only data not yet read from the connection counts, so call
+// after the event queue has been checked.  Returns false if the time ran out.
+_Bool loop_wait(long long timeout_us);
+
+#endif
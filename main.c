@@ -23,6 +23,8 @@
 #include "evilwm.h"
 #include "list.h"
 #include "log.h"
+#include "loop.h"
+#include "stats.h"
 #include "xalloc.h"
 #include "xconfig.h"
 
@@ -65,6 +67,8 @@ static struct xconfig_option evilwm_options[] = {
 	{ XCONFIG_INT,      "bw",           { .i = &option.bw } },
 	{ XCONFIG_STR_LIST, "term",         { .sl = &option.term } },
 	{ XCONFIG_INT,      "snap",         { .i = &option.snap } },
+	{ XCONFIG_INT,      "dragrate",     { .i = &option.dragrate } },
+	{ XCONFIG_INT,      "configdelay",  { .i = &option.configdelay } },
 	{ XCONFIG_BOOL,     "wholescreen",  { .i = &option.wholescreen } },
 	{ XCONFIG_STRING,   "mask1",        { .s = &opt_grabmask1 } },
 	{ XCONFIG_STRING,   "mask2",        { .s = &opt_grabmask2 } },
@@ -83,6 +87,10 @@ static struct xconfig_option evilwm_options[] = {
 	{ XCONFIG_CALL_0,   "s",            { .c0 = &set_app_fixed } },
 #ifdef SOLIDDRAG
 	{ XCONFIG_BOOL,     "nosoliddrag",  { .i = &option.no_solid_drag } },
+	{ XCONFIG_BOOL,     "solidresize",  { .i = &option.solid_resize } },
+#endif
+#ifdef STATS
+	{ XCONFIG_STRING,   "statsfile",    { .s = &option.statsfile } },
 #endif
 	{ XCONFIG_END, NULL, { .i = NULL } }
 };
@@ -102,10 +110,18 @@ static void helptext(void) {
 "  --bg COLOUR         colour of inactive window frames [" DEF_BG "]\n"
 "  --bw PIXELS         default window border width [" xstr(DEF_BW) "]\n"
 "  --snap PIXELS       snap distance when dragging windows [0; disabled]\n"
+"  --dragrate HZ       maximum window moves per second when dragging\n"
+"                      [0; unlimited]\n"
+"  --configdelay MS    minimum delay between notifying a dragged client of\n"
+"                      its new position [0; none]\n"
 "  --wholescreen       ignore monitor geometries when maximising\n"
 "  --numvdesks C[xR]   logical virtual desktop geometry (columns x rows)\n"
 #ifdef SOLIDDRAG
 "  --nosoliddrag       draw outline when moving or resizing\n"
+"  --solidresize       resize windows live instead of drawing an outline\n"
+#endif
+#ifdef STATS
+"  --statsfile FILE    write event statistics here on SIGUSR1 [stderr]\n"
 #endif
 "  --mask1 MASK        modifiers for most keyboard controls [control+alt]\n"
 "  --mask2 MASK        modifiers for mouse button controls [alt]\n"
@@ -154,16 +170,17 @@ static const char *default_options[] = {
 #define NUM_DEFAULT_OPTIONS (sizeof(default_options)/sizeof(default_options[0]))
 
 int main(int argc, char *argv[]) {
-	struct sigaction act;
 	int argn = 1, ret;
 	Window old_current_window = None;
 
-	act.sa_handler = handle_signal;
-	sigemptyset(&act.sa_mask);
-	act.sa_flags = 0;
-	sigaction(SIGTERM, &act, NULL);
-	sigaction(SIGINT, &act, NULL);
-	sigaction(SIGHUP, &act, NULL);
+	loop_signal(SIGTERM, handle_signal);
+	loop_signal(SIGINT, handle_signal);
+	loop_signal(SIGHUP, handle_signal);
+#ifdef STATS
+	loop_signal(SIGUSR1, handle_signal);
+#endif
+
+	stats_init();
 
 	// Run until something signals to quit.
 	wm_exit = 0;
@@ -365,9 +382,16 @@ static void set_app_fixed(void) {
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
-// Signals configured in main() trigger a clean shutdown
+// Signals configured in main() trigger a clean shutdown.  This is called from
+// the main loop rather than from the signal handler itself.
 
 static void handle_signal(int signo) {
+#ifdef STATS
+	if (signo == SIGUSR1) {
+		stats_dump();
+		return;
+	}
+#endif
 	if (signo != SIGHUP) {
 		wm_exit = 1;
 	}
@@ -0,0 +1,76 @@
+/* evilwm - minimalist window manager for X11
+ * Copyright (C) 1999-2025 Ciaran Anscomb <evilwm@6809.org.uk>
+ * see README for license and other details. */
+
+// Monitor geometry, and assignment of windows to monitors.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "monitor.h"
+
+// Find the best monitor for one rectangle.  See monitor.h for the criteria.
+
+int monitor_closest(const struct monitor *monitors, int nmonitors,
+		    int x1, int y1, int x2, int y2, int *intersects) {
+	int midx = (x1 + x2) / 2;
+	int midy = (y1 + y2) / 2;
+	int best = 0;
+	int have_intersection = 0;
+	double best_ratio = 0.0;
+	double best_distance = 0.0;
+
+	for (int j = 0; j < nmonitors; j++) {
+		const struct monitor *m = &monitors[j];
+		int mx2 = m->x + m->width;
+		int my2 = m->y + m->height;
+		int iw = (mx2 < x2 ? mx2 : x2) - (m->x > x1 ? m->x : x1);
+		int ih = (my2 < y2 ? my2 : y2) - (m->y > y1 ? m->y : y1);
+
+		// Found an intersection: higher ratio wins
+		if (iw > 0 && ih > 0) {
+			double ratio = ((double)iw * ih) / m->area;
+			if (!have_intersection || ratio > best_ratio) {
+				have_intersection = 1;
+				best_ratio = ratio;
+				best = j;
+			}
+			continue;
+		}
+
+		// Otherwise, any previous intersection trumps distance.
+		// Distances are compared squared, so no sqrt() is needed.
+		if (have_intersection)
+			continue;
+		double dx = midx - (m->x + mx2) / 2;
+		double dy = midy - (m->y + my2) / 2;
+		double distance = dx * dx + dy * dy;
+		if (j == 0 || distance < best_distance) {
+			best_distance = distance;
+			best = j;
+		}
+	}
+
+	if (intersects)
+		*intersects = have_intersection;
+	return best;
+}
+
+// Hash the geometry of a set of monitors (32-bit FNV-1a), identifying a
+// layout.  Never 0, so that can be used to mean "no layout".
+
+unsigned long monitor_layout_hash(const struct monitor *monitors, int nmonitors) {
+	unsigned long h = 2166136261UL;
+	for (int i = 0; i < nmonitors; i++) {
+		int v[4] = { monitors[i].x, monitors[i].y, monitors[i].width, monitors[i].height };
+		for (int j = 0; j < 4; j++) {
+			unsigned u = (unsigned)v[j];
+			for (int k = 0; k < 4; k++) {
+				h ^= (u >> (k * 8)) & 0xff;
+				h = (h * 16777619UL) & 0xffffffffUL;
+			}
+		}
+	}
+	return h ? h : 1;
+}
@@ -0,0 +1,32 @@
+/* evilwm - minimalist window manager for X11
+ * Copyright (C) 1999-2025 Ciaran Anscomb <evilwm@6809.org.uk>
+ * see README for license and other details. */
+
+// Monitor geometry, and assignment of windows to monitors.
+//
+// Windows are assigned to the monitor they have the largest intersection
+// ratio with or, if they don't intersect any (ie not visible), the one with
+// the closest mid point.
+//
+// Largest ratio should mean that if one monitor is a subset of another, a
+// window within it will be considered to be "closest" to the smaller monitor
+// for the purpose of maximising, etc.
+
+#ifndef EVILWM_MONITOR_H_
+#define EVILWM_MONITOR_H_
+
+struct monitor {
+	int x, y;
+	int width, height;
+	int area;
+};
+
+// Find the best monitor for one rectangle.  If 'intersects' is not NULL, it
+// is set to whether the rectangle intersects any monitor.
+int monitor_closest(const struct monitor *monitors, int nmonitors,
+		    int x1, int y1, int x2, int y2, int *intersects);
+
+// Hash the geometry of a set of monitors, identifying a layout.  Never 0.
+unsigned long monitor_layout_hash(const struct monitor *monitors, int nmonitors);
+
+#endif
@@ -14,6 +14,7 @@
 #include <unistd.h>
 
 #include <X11/X.h>
+#include <X11/Xatom.h>
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 
@@ -26,9 +27,10 @@
 #include "display.h"
 #include "evilwm.h"
 #include "ewmh.h"
-#include "list.h"
 #include "log.h"
+#include "monitor.h"
 #include "screen.h"
+#include "stats.h"
 #include "util.h"
 #include "xalloc.h"
 
@@ -61,13 +63,21 @@ void screen_init(struct screen *s) {
 	s->display = screen_to_display_str(i);
 
 	s->root = RootWindow(display.dpy, i);
+	s->ewmh_dirty = 0;
+	s->client_list = (struct window_array){ NULL, 0, 0 };
+	s->client_list_stacking = (struct window_array){ NULL, 0, 0 };
 #ifdef RANDR
 	s->nmonitors = 0;
 	s->monitors = NULL;
+	s->old_nmonitors = 0;
+	s->old_monitors = NULL;
+	s->randr_changes = 0;
+	s->randr_clients_moved = 0;
         if (display.have_randr) {
 		XRRSelectInput(display.dpy, s->root, RRScreenChangeNotifyMask);
 	}
 #endif
+	s->monitor_generation = 0;
 	screen_probe_monitors(s);
 
 	// Default to first virtual desktop.  TODO: consider checking the
@@ -75,6 +85,14 @@ void screen_init(struct screen *s) {
 	// change this default?
 	s->vdesk = 0;
 
+	s->nvdesks = 0;
+	s->vdesk_clients = NULL;
+	s->fixed_clients = (struct client_list){ NULL, NULL, CLIENT_LINK_VDESK };
+#ifdef STATS
+	s->vdesk_switches = 0;
+	s->vdesk_switch_us = 0;
+#endif
+
 	// In case the visual for this screen uses a colourmap, ensure our
 	// border colours are in it.
 	XColor dummy;
@@ -82,9 +100,8 @@ void screen_init(struct screen *s) {
 	XAllocNamedColor(display.dpy, DefaultColormap(display.dpy, i), option.bg, &s->bg, &dummy);
 	XAllocNamedColor(display.dpy, DefaultColormap(display.dpy, i), option.fc, &s->fc, &dummy);
 
-	// When dragging an outline, we use an inverting graphics context
-	// (GCFunction + GXinvert) so that simply drawing it again will erase
-	// it from the screen.
+	// Text in the info window and outline label is drawn with an inverting
+	// graphics context (GCFunction + GXinvert).
 
 	XGCValues gv;
 	gv.function = GXinvert;
@@ -94,13 +111,29 @@ void screen_init(struct screen *s) {
 	s->invert_gc = XCreateGC(display.dpy, s->root,
 				 GCFunction | GCSubwindowMode | GCLineWidth | GCFont, &gv);
 
+	// Outlines shown while sweeping or dragging are made from unmanaged
+	// windows, mapped only while in use.  Drawing on the root window
+	// instead would require grabbing the server.
+
+	XSetWindowAttributes attr;
+	attr.override_redirect = True;
+	attr.background_pixel = s->fg.pixel;
+	attr.save_under = True;
+	for (int j = 0; j < 4; j++) {
+		s->outline[j] = XCreateWindow(display.dpy, s->root, 0, 0, 1, 1, 0,
+					      CopyFromParent, InputOutput, CopyFromParent,
+					      CWOverrideRedirect | CWBackPixel | CWSaveUnder, &attr);
+	}
+	s->outline_label = XCreateWindow(display.dpy, s->root, 0, 0, 1, 1, 0,
+					 CopyFromParent, InputOutput, CopyFromParent,
+					 CWOverrideRedirect | CWBackPixel | CWSaveUnder, &attr);
+
 	// We handle events to the root window:
 	// SubstructureRedirectMask - create, destroy, configure window notifications
 	// SubstructureNotifyMask - configure window requests
 	// EnterWindowMask - enter events
 	// ColormapChangeMask - when a new colourmap is needed
 
-	XSetWindowAttributes attr;
 	attr.event_mask = SubstructureRedirectMask | SubstructureNotifyMask
 	                  | EnterWindowMask | ColormapChangeMask;
 	XChangeWindowAttributes(display.dpy, s->root, CWEventMask, &attr);
@@ -151,6 +184,10 @@ void screen_init(struct screen *s) {
 		X_ATOM(_NET_WM_ACTION_CHANGE_DESKTOP),
 		X_ATOM(_NET_WM_ACTION_CLOSE),
 		X_ATOM(_NET_FRAME_EXTENTS),
+#ifdef XSYNC
+		X_ATOM(_NET_WM_SYNC_REQUEST),
+		X_ATOM(_NET_WM_SYNC_REQUEST_COUNTER),
+#endif
 	};
 
 	unsigned long num_desktops = option.vdeskcolumns * option.vdeskrows;
@@ -199,7 +236,16 @@ void screen_deinit(struct screen *s) {
 	XDeleteProperty(display.dpy, s->root, X_ATOM(_NET_WORKAREA));
 	XDeleteProperty(display.dpy, s->root, X_ATOM(_NET_SUPPORTING_WM_CHECK));
 	XDestroyWindow(display.dpy, s->supporting);
+	for (int i = 0; i < 4; i++)
+		XDestroyWindow(display.dpy, s->outline[i]);
+	XDestroyWindow(display.dpy, s->outline_label);
 	free(s->monitors);
+#ifdef RANDR
+	free(s->old_monitors);
+#endif
+	free(s->vdesk_clients);
+	free(s->client_list.windows);
+	free(s->client_list_stacking.windows);
 }
 
 // Get a list of monitors for the screen.  If Randr >= 1.5 is unavailable, or
@@ -207,6 +253,9 @@ void screen_deinit(struct screen *s) {
 // covering the whole screen.
 
 void screen_probe_monitors(struct screen *s) {
+	// Invalidate any closest monitor cached for clients
+	s->monitor_generation++;
+
 #if defined(RANDR) && (RANDR_MAJOR == 1) && (RANDR_MINOR >= 5)
         if (display.have_randr && !option.wholescreen) {
 		int nmonitors;
@@ -235,6 +284,7 @@ void screen_probe_monitors(struct screen *s) {
 				}
 				s->nmonitors = nmonitors;
 			}
+			s->monitor_layout = monitor_layout_hash(s->monitors, s->nmonitors);
 			LOG_XLEAVE();
 			XRRFreeMonitors(monitors);
 			return;
@@ -252,11 +302,31 @@ void screen_probe_monitors(struct screen *s) {
 	s->monitors[0].width = DisplayWidth(display.dpy, s->screen);
 	s->monitors[0].height = DisplayHeight(display.dpy, s->screen);
 	s->monitors[0].area = s->monitors[0].width * s->monitors[0].height;
+	s->monitor_layout = monitor_layout_hash(s->monitors, s->nmonitors);
+}
+
+// Find the list of clients on a screen for a vdesk, or the list of fixed
+// clients.  The number of vdesks may change when configuration is reread, so
+// the array of per-vdesk lists is extended as needed.
+
+struct client_list *screen_vdesk_clients(struct screen *s, unsigned v) {
+	if (v == VDESK_FIXED)
+		return &s->fixed_clients;
+	if (v >= s->nvdesks) {
+		unsigned n = (v | 7) + 1;
+		s->vdesk_clients = xrealloc(s->vdesk_clients, n * sizeof(struct client_list));
+		for (unsigned i = s->nvdesks; i < n; i++) {
+			s->vdesk_clients[i] = (struct client_list){ NULL, NULL, CLIENT_LINK_VDESK };
+		}
+		s->nvdesks = n;
+	}
+	return &s->vdesk_clients[v];
 }
 
 // Switch virtual desktop.  Hides clients on different vdesks, shows clients on
 // the selected one.  Docks are always shown (unless user has hidden them
-// explicitly).  Fixed clients are always shown.
+// explicitly).  Fixed clients are always shown.  Only the clients on the old
+// and new vdesks are visited.
 
 void switch_vdesk(struct screen *s, unsigned v) {
 #ifdef DEBUG
@@ -279,24 +349,47 @@ void switch_vdesk(struct screen *s, unsigned v) {
 		select_client(NULL);
 	}
 
-	for (struct list *iter = clients_tab_order; iter; iter = iter->next) {
-		struct client *c = iter->data;
-		if (c->screen != s)
-			continue;
-		if (c->vdesk == s->vdesk) {
-			client_hide(c);
-#ifdef DEBUG
-			nhidden++;
+#ifdef STATS
+	long long start_us = get_time_us();
 #endif
-		} else if (c->vdesk == v) {
-			if (!c->is_dock || s->docks_visible)
-				client_show(c);
+
+	// Rather than hiding and showing clients one at a time, issue all the
+	// map and unmap requests together, then all the WM_STATE changes, and
+	// flush once.  Map the new vdesk's clients from the top of the stack
+	// down, then unmap the old vdesk's clients from the bottom up, so the
+	// windows that remain visible longest are the topmost ones.
+
+	// Ensure both lists exist before taking pointers to them, as looking
+	// one up may reallocate the array.
+	screen_vdesk_clients(s, v > s->vdesk ? v : s->vdesk);
+	struct client_list *old_clients = screen_vdesk_clients(s, s->vdesk);
+	struct client_list *new_clients = screen_vdesk_clients(s, v);
+
+	for (struct client *c = new_clients->tail; c; c = client_list_prev(new_clients, c)) {
+		if (!c->is_dock || s->docks_visible) {
+			XMapWindow(display.dpy, c->parent);
 #ifdef DEBUG
 			nraised++;
 #endif
 		}
 	}
 
+	for (struct client *c = old_clients->head; c; c = client_list_next(old_clients, c)) {
+		c->ignore_unmap++;  // ignore unmap so we don't remove client
+		XUnmapWindow(display.dpy, c->parent);
+#ifdef DEBUG
+		nhidden++;
+#endif
+	}
+
+	for (struct client *c = new_clients->tail; c; c = client_list_prev(new_clients, c)) {
+		if (!c->is_dock || s->docks_visible)
+			set_wm_state(c, NormalState);
+	}
+	for (struct client *c = old_clients->head; c; c = client_list_next(old_clients, c)) {
+		set_wm_state(c, IconicState);
+	}
+
 	// Store previous vdesk, so that user may toggle back to it
 	s->old_vdesk = s->vdesk;
 
@@ -304,7 +397,18 @@ void switch_vdesk(struct screen *s, unsigned v) {
 	s->vdesk = v;
 	ewmh_set_net_current_desktop(s);
 
+	XFlush(display.dpy);
+
+#ifdef STATS
+	// Record how long it took to issue the switch
+	long long switch_us = get_time_us() - start_us;
+	s->vdesk_switches++;
+	s->vdesk_switch_us += switch_us;
+	LOG_DEBUG("%d hidden, %d raised, %lldus (average %lldus)\n", nhidden, nraised,
+		  switch_us, s->vdesk_switch_us / s->vdesk_switches);
+#else
 	LOG_DEBUG("%d hidden, %d raised\n", nhidden, nraised);
+#endif
 	LOG_LEAVE();
 }
 
@@ -318,8 +422,7 @@ void set_docks_visible(struct screen *s, int is_visible) {
 	// Traverse client list and hide or show any docks on this screen as
 	// appropriate.
 
-	for (struct list *iter = clients_tab_order; iter; iter = iter->next) {
-		struct client *c = iter->data;
+	for (struct client *c = clients_tab_order.head; c; c = client_list_next(&clients_tab_order, c)) {
 		if (c->screen != s)
 			continue;
 		if (c->is_dock) {
@@ -356,16 +459,101 @@ void set_docks_visible(struct screen *s, int is_visible) {
 //      proportional position within its nearest monitor
 //   4) adjust geometry of maximised clients to any "new" monitor
 
-// Record old monitor offset for each client before resize.
+// Remember client's geometry under a monitor layout.  Replaces any entry
+// already held for that layout, else the least recently used one.
+
+static void remember_client_layout(struct client *c, unsigned long layout) {
+	int i;
+	for (i = 0; i < NUM_CLIENT_LAYOUTS - 1; i++) {
+		if (c->layouts[i].layout == layout)
+			break;
+	}
+	// Move entries down to make room at the front
+	for (; i > 0; i--)
+		c->layouts[i] = c->layouts[i-1];
+	c->layouts[0] = (struct client_layout){
+		.layout = layout,
+		.x = c->x, .y = c->y, .width = c->width, .height = c->height,
+		.oldx = c->oldx, .oldy = c->oldy, .oldw = c->oldw, .oldh = c->oldh,
+		.border = c->border,
+	};
+}
+
+// Rewrite the properties that record a client's unmaximised geometry, as
+// client_move.c does when maximising, so the state survives a restart.
+
+static void set_unmaximised_props(struct client *c) {
+	unsigned long props[2];
+	if (c->oldw) {
+		props[0] = c->oldx;
+		props[1] = c->oldw;
+		XChangeProperty(display.dpy, c->window, X_ATOM(_EVILWM_UNMAXIMISED_HORZ),
+				XA_CARDINAL, 32, PropModeReplace,
+				(unsigned char *)&props, 2);
+	} else {
+		XDeleteProperty(display.dpy, c->window, X_ATOM(_EVILWM_UNMAXIMISED_HORZ));
+	}
+	if (c->oldh) {
+		props[0] = c->oldy;
+		props[1] = c->oldh;
+		XChangeProperty(display.dpy, c->window, X_ATOM(_EVILWM_UNMAXIMISED_VERT),
+				XA_CARDINAL, 32, PropModeReplace,
+				(unsigned char *)&props, 2);
+	} else {
+		XDeleteProperty(display.dpy, c->window, X_ATOM(_EVILWM_UNMAXIMISED_VERT));
+	}
+}
+
+// Find client's remembered geometry for a monitor layout.
+
+static struct client_layout *find_client_layout(struct client *c, unsigned long layout) {
+	for (int i = 0; i < NUM_CLIENT_LAYOUTS; i++) {
+		if (c->layouts[i].layout == layout)
+			return &c->layouts[i];
+	}
+	return NULL;
+}
+
+// Has the monitor a client was on before resize been removed or changed?
+
+static _Bool old_monitor_changed(struct screen *s, struct client *c) {
+	const struct monitor *old = &s->old_monitors[c->mon_old];
+	for (int i = 0; i < s->nmonitors; i++) {
+		const struct monitor *m = &s->monitors[i];
+		if (m->x == old->x && m->y == old->y
+		    && m->width == old->width && m->height == old->height)
+			return 0;
+	}
+	return 1;
+}
+
+// Find the closest monitor to a client, as client_monitor() would, but
+// against the screen's current list of monitors.
+
+static int client_closest_monitor(struct screen *s, struct client *c, int *intersects) {
+	int x1 = c->x - c->border;
+	int y1 = c->y - c->border;
+	return monitor_closest(s->monitors, s->nmonitors, x1, y1,
+			       x1 + c->width + c->border*2,
+			       y1 + c->height + c->border*2, intersects);
+}
+
+// Record old monitor offset for each client before resize, and remember its
+// geometry under the current layout.
 
 void scan_clients_before_resize(struct screen *s) {
-	for (struct list *iter = clients_tab_order; iter; iter = iter->next) {
-		struct client *c = iter->data;
+	// Keep a copy of the current monitors to compare against afterwards
+	s->old_monitors = xrealloc(s->old_monitors, s->nmonitors * sizeof(struct monitor));
+	memcpy(s->old_monitors, s->monitors, s->nmonitors * sizeof(struct monitor));
+	s->old_nmonitors = s->nmonitors;
+
+	for (struct client *c = clients_tab_order.head; c; c = client_list_next(&clients_tab_order, c)) {
 		// only handle clients on the screen being resized
 		if (c->screen != s)
 			continue;
 
-		struct monitor *m = client_monitor(c, NULL);
+		c->mon_old = client_closest_monitor(s, c, NULL);
+		struct monitor *m = &s->monitors[c->mon_old];
 
 		int mw = m->width;
 		int mh = m->height;
@@ -374,19 +562,58 @@ void scan_clients_before_resize(struct screen *s) {
 
 		c->mon_offx = (double)(cx - m->x) / (double)mw;
 		c->mon_offy = (double)(cy - m->y) / (double)mh;
+
+		remember_client_layout(c, s->monitor_layout);
 	}
 }
 
-// Fix up maximised and non-intersecting clients after resize.
+// Fix up maximised and non-intersecting clients after resize.  If the new
+// layout has been seen before, clients are returned to where they were then.
+// Otherwise, clients whose monitor is still present with the same geometry
+// are left alone, as are any whose geometry ends up unchanged.
 
-void fix_screen_after_resize(struct screen *s) {
-	for (struct list *iter = clients_tab_order; iter; iter = iter->next) {
-		struct client *c = iter->data;
+unsigned fix_screen_after_resize(struct screen *s) {
+	unsigned moved = 0;
+	for (struct client *c = clients_tab_order.head; c; c = client_list_next(&clients_tab_order, c)) {
 		// only handle clients on the screen being resized
 		if (c->screen != s)
 			continue;
-		Bool intersects;
-		struct monitor *m = client_monitor(c, &intersects);
+		int old_x = c->x, old_y = c->y;
+		int old_width = c->width, old_height = c->height;
+		int old_border = c->border;
+
+		struct client_layout *cl = find_client_layout(c, s->monitor_layout);
+		if (cl) {
+			_Bool state_changed = (!cl->oldw != !c->oldw) || (!cl->oldh != !c->oldh);
+			c->x = cl->x;
+			c->y = cl->y;
+			c->width = cl->width;
+			c->height = cl->height;
+			c->oldx = cl->oldx;
+			c->oldy = cl->oldy;
+			c->oldw = cl->oldw;
+			c->oldh = cl->oldh;
+			if (state_changed) {
+				if (c->border != cl->border) {
+					c->border = cl->border;
+					XSetWindowBorderWidth(display.dpy, c->parent, c->border);
+					ewmh_set_net_frame_extents(c->window, c->border);
+				}
+				set_unmaximised_props(c);
+				ewmh_set_net_wm_state(c);
+			}
+			if (c->x != old_x || c->y != old_y || c->border != old_border
+			    || c->width != old_width || c->height != old_height) {
+				client_moveresize(c);
+				moved++;
+			}
+			continue;
+		}
+
+		if (!old_monitor_changed(s, c))
+			continue;
+		int intersects;
+		struct monitor *m = &s->monitors[client_closest_monitor(s, c, &intersects)];
 
 		if (c->oldw) {
 			// horiz maximised: update width, update old x pos
@@ -409,8 +636,16 @@ void fix_screen_after_resize(struct screen *s) {
 			if (!intersects)
 				c->y = m->y + c->mon_offy * m->height;
 		}
-		client_moveresize(c);
+
+		if (c->x != old_x || c->y != old_y
+		    || c->width != old_width || c->height != old_height) {
+			client_moveresize(c);
+			moved++;
+		}
 	}
+	s->randr_changes++;
+	s->randr_clients_moved += moved;
+	return moved;
 }
 
 #endif
@@ -434,6 +669,7 @@ struct screen *find_current_screen(void) {
 	unsigned dui;  // dummy
 
 	// XQueryPointer is useful for getting the current pointer root
+	stats_round_trip();
 	XQueryPointer(display.dpy, display.screens[0].root, &cur_root, &dw, &di, &di, &di, &di, &dui);
 	return find_screen(cur_root);
 }
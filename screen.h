@@ -20,10 +20,15 @@
 #include <X11/extensions/Xrandr.h>
 #endif
 
-struct monitor {
-	int x, y;
-	int width, height;
-	int area;
+#include "client.h"
+#include "monitor.h"
+
+// Array of windows in the form needed to set a property in one hit.
+
+struct window_array {
+	Window *windows;
+	unsigned nwindows;
+	unsigned size;
 };
 
 struct screen {
@@ -32,15 +37,48 @@ struct screen {
 	Window root;         // root window of screen
 	Window supporting;   // dummy window for EWMH
 	Window active;       // current _NET_ACTIVE_WINDOW value for root
-	GC invert_gc;        // used to draw outlines
+	GC invert_gc;        // used to draw info window text
+	Window outline[4];   // edges of outline shown during sweep/drag
+	Window outline_label; // geometry shown with outline
 	XColor fg, bg, fc;   // allocated colours; active, inactive, fixed
 	unsigned vdesk;      // current vdesk for screen
 	unsigned old_vdesk;  // previous vdesk, so user may toggle back to it
 	int docks_visible;   // docks can be toggled visible/hidden
+	unsigned ewmh_dirty; // root properties needing update, EWMH_DIRTY_*
+
+	// Client windows in mapping and stacking order, maintained as clients
+	// are added, removed and restacked, for _NET_CLIENT_LIST and
+	// _NET_CLIENT_LIST_STACKING.
+	struct window_array client_list;
+	struct window_array client_list_stacking;
+
+	// Clients on each vdesk, and fixed clients.  Each list is kept in
+	// stacking order (bottom to top).  The vdesk array is grown on demand.
+	unsigned nvdesks;
+	struct client_list *vdesk_clients;
+	struct client_list fixed_clients;
+
+#ifdef STATS
+	// Count of vdesk switches, and total time spent issuing them
+	unsigned long vdesk_switches;
+	long long vdesk_switch_us;
+#endif
 
 	// from randr, or just one entry with screen dimensions if no randr
 	int nmonitors;       // number of monitors
 	struct monitor *monitors;
+	unsigned monitor_generation;  // incremented when monitors are probed
+	unsigned long monitor_layout; // hash of monitor geometries
+
+#ifdef RANDR
+	// Monitors as they were before a resize, for comparison after
+	int old_nmonitors;
+	struct monitor *old_monitors;
+
+	// Count of RandR changes, and clients moved because of them
+	unsigned long randr_changes;
+	unsigned long randr_clients_moved;
+#endif
 };
 
 // Setup and shutdown.
@@ -50,6 +88,9 @@ void screen_deinit(struct screen *s);
 // Probe monitors (Randr)
 void screen_probe_monitors(struct screen *s);
 
+// Find the list of clients on a screen for a vdesk (or VDESK_FIXED).
+struct client_list *screen_vdesk_clients(struct screen *s, unsigned v);
+
 // Switch vdesks; hides & shows clients accordingly.
 void switch_vdesk(struct screen *s, unsigned v);
 
@@ -60,8 +101,8 @@ void set_docks_visible(struct screen *s, int is_visible);
 void scan_clients_before_resize(struct screen *s);
 
 // Xrandr allows a screen to resize; this function adjusts the position of
-// clients so they remain visible.
-void fix_screen_after_resize(struct screen *s);
+// clients so they remain visible.  Returns the number of clients moved.
+unsigned fix_screen_after_resize(struct screen *s);
 
 // Find screen corresponding to specified root window.
 struct screen *find_screen(Window root);
@@ -0,0 +1,198 @@
+/* evilwm - minimalist window manager for X11
+ * Copyright (C) 1999-2025 Ciaran Anscomb <evilwm@6809.org.uk>
+ * see README for license and other details. */
+
+// Event loop instrumentation.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef STATS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <X11/X.h>
+#include <X11/Xlib.h>
+
+#include "display.h"
+#include "evilwm.h"
+#include "log.h"
+#include "screen.h"
+#include "stats.h"
+#include "util.h"
+#include "xalloc.h"
+
+struct stats stats;
+
+static const char *event_names[LASTEvent + 1] = {
+	[KeyPress] = "KeyPress",
+	[KeyRelease] = "KeyRelease",
+	[ButtonPress] = "ButtonPress",
+	[ButtonRelease] = "ButtonRelease",
+	[MotionNotify] = "MotionNotify",
+	[EnterNotify] = "EnterNotify",
+	[LeaveNotify] = "LeaveNotify",
+	[FocusIn] = "FocusIn",
+	[FocusOut] = "FocusOut",
+	[KeymapNotify] = "KeymapNotify",
+	[Expose] = "Expose",
+	[GraphicsExpose] = "GraphicsExpose",
+	[NoExpose] = "NoExpose",
+	[VisibilityNotify] = "VisibilityNotify",
+	[CreateNotify] = "CreateNotify",
+	[DestroyNotify] = "DestroyNotify",
+	[UnmapNotify] = "UnmapNotify",
+	[MapNotify] = "MapNotify",
+	[MapRequest] = "MapRequest",
+	[ReparentNotify] = "ReparentNotify",
+	[ConfigureNotify] = "ConfigureNotify",
+	[ConfigureRequest] = "ConfigureRequest",
+	[GravityNotify] = "GravityNotify",
+	[ResizeRequest] = "ResizeRequest",
+	[CirculateNotify] = "CirculateNotify",
+	[CirculateRequest] = "CirculateRequest",
+	[PropertyNotify] = "PropertyNotify",
+	[SelectionClear] = "SelectionClear",
+	[SelectionRequest] = "SelectionRequest",
+	[SelectionNotify] = "SelectionNotify",
+	[ColormapNotify] = "ColormapNotify",
+	[ClientMessage] = "ClientMessage",
+	[MappingNotify] = "MappingNotify",
+	[LASTEvent] = "extension",
+};
+
+void stats_init(void) {
+	memset(&stats, 0, sizeof(stats));
+	stats.type = -1;
+	stats.init_us = get_time_us();
+}
+
+// Note event type and start time.  Called as soon as the event is dequeued.
+
+void stats_event_begin(XEvent *ev) {
+	stats.type = (ev->type >= 0 && ev->type < LASTEvent) ? ev->type : LASTEvent;
+	stats.window = ev->xany.window;
+	stats.start_request = NextRequest(display.dpy);
+	stats.start_round_trips = stats.round_trips;
+	stats.start_us = get_time_us();
+}
+
+// Account for the event once its handler has returned.
+
+void stats_event_end(void) {
+	if (stats.type < 0)
+		return;
+	long long us = get_time_us() - stats.start_us;
+	struct event_stats *es = &stats.event[stats.type];
+	unsigned b = 0;
+	for (long long t = us; t > 0 && b < STATS_NBUCKETS - 1; t >>= 1)
+		b++;
+	es->count++;
+	es->requests += NextRequest(display.dpy) - stats.start_request;
+	es->round_trips += stats.round_trips - stats.start_round_trips;
+	es->total_us += us;
+	if (us > es->max_us) {
+		es->max_us = us;
+		es->max_window = stats.window;
+	}
+	es->histogram[b]++;
+	stats.type = -1;
+}
+
+// Percentile from histogram, reported as the upper bound of the bucket it
+// falls in.
+
+static long long percentile(const struct event_stats *es, unsigned pc) {
+	unsigned long want = (es->count * pc + 99) / 100;
+	unsigned long n = 0;
+	for (unsigned b = 0; b < STATS_NBUCKETS - 1; b++) {
+		n += es->histogram[b];
+		if (n >= want)
+			return 1LL << b;
+	}
+	return es->max_us;
+}
+
+static void dump_event_stats(FILE *f, const char *name, const struct event_stats *es) {
+	fprintf(f, "%-18s %8lu %9lu %8lu %8lld %8lld %8lld %8lld 0x%lx\n",
+		name, es->count, es->requests, es->round_trips,
+		es->total_us / (long long)es->count,
+		percentile(es, 50), percentile(es, 99), es->max_us,
+		(unsigned long)es->max_window);
+}
+
+// When writing to a file, the summary goes to a temporary file that is then
+// renamed into place, so that anything reading it never sees a partial dump.
+
+void stats_dump(void) {
+	FILE *f = stderr;
+	char *tmpname = NULL;
+	struct event_stats all;
+
+	if (option.statsfile) {
+		tmpname = xmalloc(strlen(option.statsfile) + sizeof(".tmp"));
+		strcpy(tmpname, option.statsfile);
+		strcat(tmpname, ".tmp");
+		f = fopen(tmpname, "w");
+		if (!f) {
+			LOG_ERROR("can't open stats file %s\n", tmpname);
+			free(tmpname);
+			return;
+		}
+	}
+
+	fprintf(f, "uptime_us %lld\n", get_time_us() - stats.init_us);
+	fprintf(f, "adopted %u in %lldus\n", display.adopted_clients, display.adopt_us);
+	fprintf(f, "round_trips %lu\n", stats.round_trips);
+	fprintf(f, "motion_coalesced %lu\n", stats.motion_coalesced);
+	fprintf(f, "coalesced configure %lu property %lu enter %lu\n",
+		stats.configure_coalesced, stats.property_coalesced,
+		stats.enter_coalesced);
+	for (int i = 0; i < display.nscreens; i++) {
+		struct screen *s = &display.screens[i];
+		fprintf(f, "screen %d vdesk_switches %lu in %lldus\n",
+			s->screen, s->vdesk_switches, s->vdesk_switch_us);
+#ifdef RANDR
+		fprintf(f, "screen %d randr_changes %lu moved %lu clients\n",
+			s->screen, s->randr_changes, s->randr_clients_moved);
+#endif
+	}
+
+	fprintf(f, "%-18s %8s %9s %8s %8s %8s %8s %8s %s\n", "event", "count",
+		"requests", "rtrips", "mean_us", "p50_us", "p99_us", "max_us",
+		"max_window");
+	memset(&all, 0, sizeof(all));
+	for (int i = 0; i <= LASTEvent; i++) {
+		const struct event_stats *es = &stats.event[i];
+		if (!es->count)
+			continue;
+		dump_event_stats(f, event_names[i] ? event_names[i] : "unknown", es);
+		all.count += es->count;
+		all.requests += es->requests;
+		all.round_trips += es->round_trips;
+		all.total_us += es->total_us;
+		if (es->max_us > all.max_us) {
+			all.max_us = es->max_us;
+			all.max_window = es->max_window;
+		}
+		for (unsigned b = 0; b < STATS_NBUCKETS; b++)
+			all.histogram[b] += es->histogram[b];
+	}
+	if (all.count)
+		dump_event_stats(f, "all", &all);
+
+	if (f == stderr) {
+		fflush(f);
+		return;
+	}
+	if (fclose(f) != 0 || rename(tmpname, option.statsfile) != 0) {
+		LOG_ERROR("can't write stats file %s\n", option.statsfile);
+		remove(tmpname);
+	}
+	free(tmpname);
+}
+
+#endif
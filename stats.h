@@ -0,0 +1,86 @@
+/* evilwm - minimalist window manager for X11
+ * Copyright (C) 1999-2025 Ciaran Anscomb <evilwm@6809.org.uk>
+ * see README for license and other details. */
+
+// Event loop instrumentation.
+//
+// For each event type, counts events handled, X requests issued and blocking
+// round trips made by the handler, and keeps a histogram of time taken from
+// dequeue to handler return.  A summary is written out on SIGUSR1.
+//
+// Without STATS defined, all of this compiles away to nothing.
+
+#ifndef EVILWM_STATS_H_
+#define EVILWM_STATS_H_
+
+#ifdef STATS
+
+#include <X11/X.h>
+#include <X11/Xlib.h>
+
+// Histogram buckets: bucket i counts latencies < 2^i microseconds, the last
+// bucket counts anything longer.
+#define STATS_NBUCKETS 24
+
+struct event_stats {
+	unsigned long count;
+	unsigned long requests;
+	unsigned long round_trips;
+	long long total_us;
+	long long max_us;
+	Window max_window;  // event window of slowest event
+	unsigned long histogram[STATS_NBUCKETS];
+};
+
+struct stats {
+	// Indexed by event type.  Extension events share the last entry.
+	struct event_stats event[LASTEvent + 1];
+
+	// Total blocking round trips, wherever they happen
+	unsigned long round_trips;
+
+	// Motion events skipped during drags as a later one was queued
+	unsigned long motion_coalesced;
+
+	// Queued events merged into one being handled by the main loop
+	unsigned long configure_coalesced;
+	unsigned long property_coalesced;
+	unsigned long enter_coalesced;
+
+	// Event currently being handled
+	int type;
+	Window window;
+	long long start_us;
+	unsigned long start_request;
+	unsigned long start_round_trips;
+
+	long long init_us;
+};
+
+extern struct stats stats;
+
+void stats_init(void);
+void stats_event_begin(XEvent *ev);
+void stats_event_end(void);
+
+// Called alongside any Xlib call that waits for a reply.  Prefer the wrappers
+// in util.h, which do this already.
+#define stats_round_trip() ((void)stats.round_trips++)
+
+// Add to one of the miscellaneous counters
+#define stats_count(f, n) ((void)(stats.f += (n)))
+
+// Write summary to the file named by the "statsfile" option, or to stderr.
+void stats_dump(void);
+
+#else
+
+# define stats_init() do { } while (0)
+# define stats_event_begin(e) do { } while (0)
+# define stats_event_end() do { } while (0)
+# define stats_round_trip() ((void)0)
+# define stats_count(f, n) ((void)0)
+
+#endif
+
+#endif
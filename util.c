@@ -8,11 +8,10 @@
 #include "config.h"
 #endif
 
-#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/select.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <X11/X.h>
@@ -25,14 +24,35 @@
 #include "evilwm.h"
 #include "log.h"
 #include "screen.h"
+#include "stats.h"
 #include "util.h"
-
-// For get_property()
-#define MAXIMUM_PROPERTY_LENGTH 4096
-
-// Error handler interaction
-int ignore_xerror = 0;
-volatile Window initialising = None;
+#include "xalloc.h"
+
+// Ranges of requests for which errors are expected.  One range may be open
+// (still being added to) at a time; closed ranges are kept until the server
+// is known to have processed their last request.
+
+struct xerror_expect {
+	unsigned long first;  // serial of first request in range
+	unsigned long last;   // serial of last request in range
+	Window w;             // resource errors are expected for
+	unsigned nerrors;     // number of matching errors seen
+};
+
+static struct xerror_expect xerror_open;
+static _Bool xerror_is_open = 0;
+static struct xerror_expect *xerror_expects = NULL;
+static unsigned xerror_nexpects = 0;
+static unsigned xerror_expects_size = 0;
+
+// Enter events generated before the marker request with this serial are
+// ignored.  See discard_enter_events().
+
+static struct {
+	_Bool active;
+	unsigned long serial;
+	Window except;
+} discard_enter;
 
 // Spawn a subprocess by fork()ing twice so we don't have to worry about
 // SIGCHLDs.
@@ -60,6 +80,85 @@ void spawn(const char *const cmd[]) {
 		wait(NULL);
 }
 
+// Serial comparison that survives wraparound.
+
+static _Bool serial_le(unsigned long a, unsigned long b) {
+	return (long)(b - a) >= 0;
+}
+
+// Start a range of requests for which errors concerning window w are
+// expected, e.g. because it may already have been destroyed.  Requests are
+// not delayed and the server is not grabbed: any error that turns up later is
+// attributed by its serial number.
+
+void xerror_expect_begin(Window w) {
+	xerror_open.first = NextRequest(display.dpy);
+	xerror_open.w = w;
+	xerror_open.nerrors = 0;
+	xerror_is_open = 1;
+}
+
+// Close the open range.  Returns the number of matching errors seen so far,
+// which only includes requests that have already been waited on.
+
+unsigned xerror_expect_end(void) {
+	unsigned long processed = LastKnownRequestProcessed(display.dpy);
+	unsigned nerrors = xerror_open.nerrors;
+
+	xerror_is_open = 0;
+	xerror_open.last = NextRequest(display.dpy) - 1;
+
+	// Empty range, or all requests already processed: nothing to keep.
+	if (xerror_open.last == xerror_open.first - 1
+	    || serial_le(xerror_open.last, processed))
+		return nerrors;
+
+	// Discard ranges the server has finished with.
+	unsigned j = 0;
+	for (unsigned i = 0; i < xerror_nexpects; i++) {
+		if (!serial_le(xerror_expects[i].last, processed))
+			xerror_expects[j++] = xerror_expects[i];
+	}
+	xerror_nexpects = j;
+
+	if (xerror_nexpects >= xerror_expects_size) {
+		xerror_expects_size = xerror_expects_size ? xerror_expects_size * 2 : 8;
+		xerror_expects = xrealloc(xerror_expects, xerror_expects_size * sizeof(struct xerror_expect));
+	}
+	xerror_expects[xerror_nexpects++] = xerror_open;
+	return nerrors;
+}
+
+// Check whether an error was expected.  Closed ranges are in request order,
+// so any ahead of this error's serial can never match again and are dropped.
+
+static _Bool xerror_expected(XErrorEvent *e) {
+	if (xerror_is_open && e->resourceid == xerror_open.w
+	    && serial_le(xerror_open.first, e->serial)) {
+		xerror_open.nerrors++;
+		return 1;
+	}
+	unsigned drop = 0;
+	_Bool expected = 0;
+	for (unsigned i = 0; i < xerror_nexpects; i++) {
+		struct xerror_expect *x = &xerror_expects[i];
+		if (!serial_le(e->serial, x->last)) {
+			drop = i + 1;
+			continue;
+		}
+		if (serial_le(x->first, e->serial) && e->resourceid == x->w) {
+			x->nerrors++;
+			expected = 1;
+			break;
+		}
+	}
+	if (drop) {
+		xerror_nexpects -= drop;
+		memmove(xerror_expects, xerror_expects + drop, xerror_nexpects * sizeof(struct xerror_expect));
+	}
+	return expected;
+}
+
 // When something we do raises an X error, we get sent here.  There are several
 // specific types of error that we know we want to ignore, or that indicate a
 // fatal error.  For the rest, cease managing the client, as it should indicate
@@ -71,21 +170,11 @@ int handle_xerror(Display *dsply, XErrorEvent *e) {
 
 	LOG_ENTER("handle_xerror(error=%d, request=%d/%d, resourceid=%lx)", e->error_code, e->request_code, e->minor_code, e->resourceid);
 
-	// Some parts of the code deliberately disable error checking.
-
-	if (ignore_xerror) {
-		LOG_DEBUG("ignoring...\n");
-		LOG_LEAVE();
-		return 0;
-	}
-
-	// client_manage_new() sets initialising to non-None to test if a
-	// window still exists.  If we end up here, the test failed, so
-	// indicate that by setting it back to None.
+	// Managing and removing clients note which windows may have gone away
+	// underneath them.  Errors for those are fine.
 
-	if (initialising != None && e->resourceid == initialising) {
-		LOG_DEBUG("error caught while initialising window=%lx\n", (unsigned long)initialising);
-		initialising = None;
+	if (xerror_expected(e)) {
+		LOG_DEBUG("expected error for window=%lx\n", (unsigned long)e->resourceid);
 		LOG_LEAVE();
 		return 0;
 	}
@@ -135,9 +224,53 @@ Bool get_pointer_root_xy(Window w, int *x, int *y) {
 		x = &root_x_r;
 	if (!y)
 		y = &root_y_r;
+	stats_round_trip();
 	return XQueryPointer(display.dpy, w, &root_r, &child_r, x, y, &win_x_r, &win_y_r, &mask_r);
 }
 
+// Wrappers for other blocking calls, so that each round trip is counted in
+// one place.
+
+Bool grab_pointer(Window w, Cursor curs) {
+	stats_round_trip();
+	return XGrabPointer(display.dpy, w, False,
+			    ButtonPressMask|ButtonReleaseMask|PointerMotionMask,
+			    GrabModeAsync, GrabModeAsync,
+			    None, curs, CurrentTime) == GrabSuccess;
+}
+
+Bool grab_keyboard(Window w) {
+	stats_round_trip();
+	return XGrabKeyboard(display.dpy, w, False, GrabModeAsync, GrabModeAsync,
+			     CurrentTime) == GrabSuccess;
+}
+
+Status get_window_attributes(Window w, XWindowAttributes *attr) {
+	stats_round_trip();
+	return XGetWindowAttributes(display.dpy, w, attr);
+}
+
+Status get_wm_protocols(Window w, Atom **protocols, int *n) {
+	stats_round_trip();
+	return XGetWMProtocols(display.dpy, w, protocols, n);
+}
+
+Status get_size_hints(Window w, XSizeHints *size) {
+	long dummy;
+	stats_round_trip();
+	return XGetWMNormalHints(display.dpy, w, size, &dummy);
+}
+
+Status get_class_hint(Window w, XClassHint *class) {
+	stats_round_trip();
+	return XGetClassHint(display.dpy, w, class);
+}
+
+Status fetch_name(Window w, char **name) {
+	stats_round_trip();
+	return XFetchName(display.dpy, w, name);
+}
+
 // Wraps XGetWindowProperty()
 
 void *get_property(Window w, Atom property, Atom req_type,
@@ -146,6 +279,7 @@ void *get_property(Window w, Atom property, Atom req_type,
 	int actual_format;
 	unsigned long bytes_after;
 	unsigned char *prop;
+	stats_round_trip();
 	if (XGetWindowProperty(display.dpy, w, property,
 			       0L, MAXIMUM_PROPERTY_LENGTH / 4, False,
 			       req_type, &actual_type, &actual_format,
@@ -157,74 +291,132 @@ void *get_property(Window w, Atom property, Atom req_type,
 	return NULL;
 }
 
+// Current time from a monotonic clock, in microseconds.  Used for timing
+// operations, so only differences between values are meaningful.
+
+long long get_time_us(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Normal border size of windows not yet managed, as found when answering
+// _NET_REQUEST_FRAME_EXTENTS.  Toolkits may ask several times before mapping
+// a window, and the same answer is needed again when it's managed.  Entries
+// are replaced in turn, and removed when a window's MWM hints change, or it's
+// managed or destroyed.
+
+#define BORDER_CACHE_SIZE (8)
+
+static struct {
+	Window w;
+	int bw;
+} border_cache[BORDER_CACHE_SIZE];
+static unsigned border_cache_next = 0;
+
+// Look up a cached normal border.  Returns false if there is none.
+
+_Bool cached_window_normal_border(Window w, int *bw) {
+	if (w == None)
+		return 0;
+	for (int i = 0; i < BORDER_CACHE_SIZE; i++) {
+		if (border_cache[i].w == w) {
+			*bw = border_cache[i].bw;
+			return 1;
+		}
+	}
+	return 0;
+}
+
 // Determine the normal border size for a window.  MWM hints seem to be the
 // only way clients can signal they don't want a border.
 
 int window_normal_border(Window w) {
-	int bw = option.bw;
+	int bw;
+	if (cached_window_normal_border(w, &bw))
+		return bw;
+
+	bw = option.bw;
 	PropMwmHints *mprop;
 	unsigned long nitems;
 	if ( (mprop = get_property(w, X_ATOM(_MOTIF_WM_HINTS), X_ATOM(_MOTIF_WM_HINTS), &nitems)) ) {
-		if (nitems >= PROP_MWM_HINTS_ELEMENTS
-		    && (mprop->flags & MWM_HINTS_DECORATIONS)
-		    && !(mprop->decorations & MWM_DECOR_ALL)
-		    && !(mprop->decorations & MWM_DECOR_BORDER)) {
-			bw = 0;
-		}
+		bw = mwm_hints_normal_border(mprop, nitems);
 		XFree(mprop);
 	}
 	return bw;
 }
 
+// Same, but remember the result for a window that isn't managed yet.  Asks to
+// be told of property changes so the entry can be invalidated.  A window
+// evicted from the cache is no longer watched.
+
+int pending_window_normal_border(Window w) {
+	int bw;
+	if (cached_window_normal_border(w, &bw))
+		return bw;
+	bw = window_normal_border(w);
+	XSelectInput(display.dpy, w, PropertyChangeMask);
+	Window old = border_cache[border_cache_next].w;
+	if (old != None) {
+		xerror_expect_begin(old);
+		XSelectInput(display.dpy, old, NoEventMask);
+		xerror_expect_end();
+	}
+	border_cache[border_cache_next].w = w;
+	border_cache[border_cache_next].bw = bw;
+	border_cache_next = (border_cache_next + 1) % BORDER_CACHE_SIZE;
+	return bw;
+}
 
-// interruptibleXNextEvent() is taken from the Blender source and comes with
-// the following copyright notice:
-//
-// Copyright (c) Mark J. Kilgard, 1994, 1995, 1996.
-//
-// This program is freely distributable without licensing fees and is provided
-// without guarantee or warrantee expressed or implied. This program is -not-
-// in the public domain.
-
-// Unlike XNextEvent, if a signal arrives, interruptibleXNextEvent will return
-// zero.
+// Forget any cached normal border for a window.  Returns true if there was
+// one, in which case the window is still selected for PropertyChangeMask.
 
-int interruptibleXNextEvent(XEvent *event) {
-	fd_set fds;
-	int rc;
-	int dpy_fd = ConnectionNumber(display.dpy);
-	for (;;) {
-		if (XPending(display.dpy)) {
-			XNextEvent(display.dpy, event);
-			return 1;
-		}
-		FD_ZERO(&fds);
-		FD_SET(dpy_fd, &fds);
-		rc = select(dpy_fd + 1, &fds, NULL, NULL, NULL);
-		if (rc < 0) {
-			if (errno == EINTR) {
-				return 0;
-			} else {
-				LOG_ERROR("interruptibleXNextEvent(): select()\n");
-			}
+_Bool forget_window_normal_border(Window w) {
+	_Bool found = 0;
+	for (int i = 0; i < BORDER_CACHE_SIZE; i++) {
+		if (border_cache[i].w == w && w != None) {
+			border_cache[i].w = None;
+			found = 1;
 		}
 	}
+	return found;
 }
 
-// Remove enter events from the queue, preserving only the last one
-// corresponding to "except"s parent.
+// Interpret already fetched MWM hints.
 
-void discard_enter_events(struct client *except) {
-	XEvent tmp, putback_ev;
-	int putback = 0;
-	XSync(display.dpy, False);
-	while (XCheckMaskEvent(display.dpy, EnterWindowMask, &tmp)) {
-		if (tmp.xcrossing.window == except->parent) {
-			memcpy(&putback_ev, &tmp, sizeof(XEvent));
-			putback = 1;
-		}
+int mwm_hints_normal_border(const PropMwmHints *mprop, unsigned long nitems) {
+	if (nitems >= PROP_MWM_HINTS_ELEMENTS
+	    && (mprop->flags & MWM_HINTS_DECORATIONS)
+	    && !(mprop->decorations & MWM_DECOR_ALL)
+	    && !(mprop->decorations & MWM_DECOR_BORDER)) {
+		return 0;
 	}
-	if (putback) {
-		XPutBackEvent(display.dpy, &putback_ev);
+	return option.bw;
+}
+
+
+// Moving windows around under the pointer generates enter events that would
+// change focus.  Rather than wait for them to arrive, send a no-op request as
+// a marker: any enter event stamped with an earlier serial was generated
+// before the server reached it, and is ignored unless it is for "except"s
+// parent.
+
+void discard_enter_events(struct client *except) {
+	discard_enter.active = 1;
+	discard_enter.serial = NextRequest(display.dpy);
+	discard_enter.except = except->parent;
+	XNoOp(display.dpy);
+}
+
+// Check an enter event against the last discard_enter_events().  The first
+// event stamped at or after the marker ends the filtering.
+
+_Bool enter_event_discarded(XCrossingEvent *e) {
+	if (!discard_enter.active)
+		return 0;
+	if (serial_le(discard_enter.serial, e->serial)) {
+		discard_enter.active = 0;
+		return 0;
 	}
+	return e->window != discard_enter.except;
 }
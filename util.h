@@ -7,6 +7,12 @@
 
 #include <X11/X.h>
 #include <X11/Xdefs.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#include "stats.h"
+
+struct client;
 
 // Required for interpreting MWM hints
 
@@ -27,21 +33,28 @@ typedef struct {
 #define NET_WM_STATE_TOGGLE     2    /* toggle property  */
 
 // Grab pointer using specified cursor.  Report button press/release, and
-// pointer motion events.
+// pointer motion events.  Returns true on success.
+Bool grab_pointer(Window w, Cursor curs);
+
+// Grab keyboard.  Returns true on success.
+Bool grab_keyboard(Window w);
 
-#define grab_pointer(w, curs) \
-	(XGrabPointer(display.dpy, w, False, \
-		      ButtonPressMask|ButtonReleaseMask|PointerMotionMask, \
-		      GrabModeAsync, GrabModeAsync, \
-		      None, curs, CurrentTime) == GrabSuccess)
+// Wrap other blocking Xlib calls, counting round trips for STATS.
+Status get_window_attributes(Window w, XWindowAttributes *attr);
+Status get_wm_protocols(Window w, Atom **protocols, int *n);
+Status get_size_hints(Window w, XSizeHints *size);
+Status get_class_hint(Window w, XClassHint *class);
+Status fetch_name(Window w, char **name);
 
 // Move the mouse pointer.
 
 #define setmouse(w, x, y) XWarpPointer(display.dpy, None, w, 0, 0, 0, 0, x, y)
 
-// Error handler interaction
-extern int ignore_xerror;
-extern volatile Window initialising;
+// Error handler interaction.  Errors concerning window w from requests made
+// between begin and end are expected, and are not treated as a reason to stop
+// managing a client.  end returns the number of such errors seen so far.
+void xerror_expect_begin(Window w);
+unsigned xerror_expect_end(void);
 
 // Spawn a subprocess (usually xterm or similar)
 void spawn(const char *const cmd[]);
@@ -53,17 +66,23 @@ int handle_xerror(Display *dsply, XErrorEvent *e);
 Bool get_pointer_root_xy(Window w, int *x, int *y); // Wraps XQueryPointer()
 
 // Wraps XGetWindowProperty()
+#define MAXIMUM_PROPERTY_LENGTH 4096
 void *get_property(Window w, Atom property, Atom req_type, unsigned long *nitems_return);
 
-// Determine the normal border size for a window.
-int window_normal_border(Window w);
+// Current time from a monotonic clock, in microseconds.
+long long get_time_us(void);
 
-// Alternative to XNextEvent().  Unlike XNextEvent, if a signal arrives,
-// interruptibleXNextEvent will return zero.
-int interruptibleXNextEvent(XEvent *event);
+// Determine the normal border size for a window.  The pending_ version
+// caches the result for windows not yet managed.
+int window_normal_border(Window w);
+int pending_window_normal_border(Window w);
+_Bool cached_window_normal_border(Window w, int *bw);
+_Bool forget_window_normal_border(Window w);
+int mwm_hints_normal_border(const PropMwmHints *mprop, unsigned long nitems);
 
-// Remove enter events from the queue, preserving only the last one
-// corresponding to "except"s parent.
+// Ignore enter events caused by anything done so far, except those for
+// "except"s parent.  Doesn't wait for the server.
 void discard_enter_events(struct client *except);
+_Bool enter_event_discarded(XCrossingEvent *e);
 
 #endif